@@ -0,0 +1,79 @@
+// ChessBot engine library: the C interface of the engine in code.cpp.
+// Build with: g++ -std=c++17 -O2 -pthread -fPIC -shared -fvisibility=hidden -DCHESSBOT_LIBRARY -o libchessbot.so code.cpp
+#ifndef CHESSBOT_H
+#define CHESSBOT_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__)
+#define CHESSBOT_API __attribute__((visibility("default")))
+#else
+#define CHESSBOT_API
+#endif
+
+// raised whenever a function or struct below changes in an incompatible way
+#define CHESSBOT_ABI_VERSION 1
+
+// return codes; functions that report counts return them instead of CHESSBOT_OK
+#define CHESSBOT_OK 0
+#define CHESSBOT_ERROR_ARGUMENT -1        // a null engine or missing argument
+#define CHESSBOT_ERROR_POSITION -2        // a malformed FEN or an illegal move
+#define CHESSBOT_ERROR_BUSY -3            // a search is running
+#define CHESSBOT_ERROR_BUFFER -4          // the buffer is too small
+#define CHESSBOT_ERROR_RESOURCES -5       // out of memory or threads
+
+typedef struct chessbot_engine chessbot_engine;
+
+typedef enum {
+    CHESSBOT_LAZY_SMP = 0,
+    CHESSBOT_YOUNG_BROTHERS_WAIT = 1
+} chessbot_parallel_mode;
+
+// What a search may use. A zero depth searches as deep as the clock allows, or until chessbot_stop_search without a
+// clock. Times are in milliseconds; with both times zero the search has no clock.
+typedef struct {
+    unsigned int depth;
+    long long white_time, black_time, white_increment, black_increment;
+    unsigned int moves_to_go;                // 0 if the time is for the rest of the game
+    unsigned int threads;                    // 0 or 1 for a single thread
+    chessbot_parallel_mode mode;
+} chessbot_limits;
+
+// Called on the search thread when a search ends, with the move in coordinate notation (e.g. "e2e4"), or "" if the side
+// to move has no legal move. Pawns always promote to queens. Until the callback returns the search counts as running:
+// chessbot_set_position, chessbot_legal_moves and chessbot_start_search return CHESSBOT_ERROR_BUSY and chessbot_wait
+// returns at once, so the next search has to be started from another thread. chessbot_destroy may be called.
+typedef void (*chessbot_bestmove_callback)(const char *move, void *user_data);
+
+CHESSBOT_API int chessbot_abi_version(void);
+
+// returns NULL if out of memory; a new engine holds the starting position
+CHESSBOT_API chessbot_engine *chessbot_create(void);
+// Stops and waits for a running search first. Called from the search's callback, it returns at once and the engine is
+// deleted when the callback returns. Either way the engine must not be used again.
+CHESSBOT_API void chessbot_destroy(chessbot_engine *engine);
+
+// Sets up the position of the FEN string (NULL or "startpos" for the starting position) and plays the space-separated
+// moves in coordinate notation after it (NULL for none). The engine keeps its position if this fails.
+CHESSBOT_API int chessbot_set_position(chessbot_engine *engine, const char *fen, const char *moves);
+
+// Writes the legal moves as a space-separated, null-terminated list and returns their number. 5 bytes per move, but at
+// least 1 for the terminator of an empty list, are always enough.
+CHESSBOT_API int chessbot_legal_moves(chessbot_engine *engine, char *buffer, size_t size);
+
+// Starts searching the current position on a thread of its own and returns at once. The callback gets the result.
+CHESSBOT_API int chessbot_start_search(chessbot_engine *engine, const chessbot_limits *limits, chessbot_bestmove_callback callback, void *user_data);
+// asks a running search to finish as soon as it has a move to report; returns without waiting
+CHESSBOT_API void chessbot_stop_search(chessbot_engine *engine);
+// waits until the current search has ended and its callback has returned; from the callback it returns at once
+CHESSBOT_API void chessbot_wait(chessbot_engine *engine);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
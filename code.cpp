@@ -7,7 +7,27 @@
 #include <vector>
 #include <map>
 #include <algorithm>
+#include <array>
+#include <chrono>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <deque>
+#include <unordered_map>
+#include <list>
+#include <functional>
+#include <condition_variable>
+#include <fstream>
+#include <sstream>
+#include <memory>
+#include <random>
+#include <cstring>
+#include <cmath>
 #include <time.h>
+#include "chessbot.h"
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 // Platform-specific includes and functions
 #ifdef _WIN32
@@ -22,6 +42,8 @@
 
 // --- Macros and Constants ---
 #define BOARD_SIZE 8
+#define MAILBOX_WIDTH 10
+#define MAILBOX_SIZE 120
 #define BOX_WIDTH 10
 #define DOWN 3
 #define RIGHT 10
@@ -29,11 +51,49 @@
 #define TO_RIGHT std::string(RIGHT, ' ')
 #define CLEAR_LINE std::string(100, ' ')
 #define MOVES_PER_LINE 5
+#define MAX_SEARCH_DEPTH 64              // depth limit of searches that are limited by a clock instead
+#define MOVE_OVERHEAD 0.03               // seconds kept in reserve per move for everything around the search
+#define DEFAULT_MOVES_TO_GO 30           // moves the remaining time is planned for when the clock does not say
+#define ROOT_TABLE_SIZE 1024             // finished root searches a bot remembers, a power of two
+#define SEARCH_HASH_MB 16                // size of the table the threads of a parallel search share
+#define MIN_SPLIT_DEPTH 2                // remaining depth below which the moves of a node are not shared out
+#define ORDERING_DEPTH 2                 // remaining depth from which the moves of a node are searched best scored first
+#define EVALUATION_BATCH_SIZE 256        // packed positions a thread evaluates at a time, about 9 KB
+#define SESSION_MOVES 100                // plies without a capture, pawn move or castling after which a session's game is drawn
+#define STORE_COMPACT_RECORDS 4096       // dead records in a session store before it may be rewritten without them
+#define ANALYSIS_CACHE_ENTRIES 4096      // finished analyses a server keeps by default
+#define LOAD_REQUESTS 200                // requests a load test synthesizes when it has no trace
+#define LOAD_DEPTH 3                     // depth of the analyses a load test synthesizes
+#define LOAD_MOVE_MILLISECONDS 100       // time of the bot moves a load test synthesizes
+#define LOAD_STEP_SECONDS 5              // how long each rate of a load test sweep is offered for
+#define LOAD_SATURATION 0.9              // share of the offered rate a server must complete to keep up with it
+
+// Build with -DCOPY_MAKE to have search and perft restore a copied BoardState instead of calling MovePieceBack.
+#ifdef COPY_MAKE
+#define MAKE_UNMAKE_MODE "copy-make"
+#else
+#define MAKE_UNMAKE_MODE "make/unmake"
+#endif
+
+// Build with -DATTACK_TABLES to have every board change keep per-square attack counts and attackers up to date, so that
+// the check test becomes a lookup instead of ray scans.
+#ifdef ATTACK_TABLES
+#define ATTACK_MODE "attack tables"
+#else
+#define ATTACK_MODE "ray scans"
+#endif
+
+#ifdef __AVX2__
+#define EVALUATION_KERNEL "AVX2"
+#else
+#define EVALUATION_KERNEL "scalar"
+#endif
 
 // --- Enums and Types ---
 typedef enum {
     B_KING = -6, B_QUEEN, B_BISHOP, B_KNIGHT, B_ROOK, B_PAWN, EMPTY,
-    W_KING, W_QUEEN, W_BISHOP, W_KNIGHT, W_ROOK, W_PAWN
+    W_KING, W_QUEEN, W_BISHOP, W_KNIGHT, W_ROOK, W_PAWN,
+    OFF_BOARD        // sentinel on the frame of the mailbox board
 } ChessPieces;
 
 typedef enum {
@@ -41,9 +101,71 @@ typedef enum {
 } Moves;
 
 typedef enum {
-    CHECKMATE, FIFTY_MOVES, THREEFOLD_REP, QUIT
+    CHECKMATE, STALEMATE, FIFTY_MOVES, THREEFOLD_REP, INSUFFICIENT_MATERIAL, TIME_FORFEIT, QUIT
 } Endgame;
 
+typedef enum {
+    BLACK, WHITE
+} Color;
+
+typedef enum {
+    CAPTURES, QUIETS, EVASIONS, NON_EVASIONS
+} GenType;
+
+typedef enum {
+    EXACT_BOUND, LOWER_BOUND, UPPER_BOUND
+} Bound;
+
+typedef enum {
+    LAZY_SMP, YOUNG_BROTHERS_WAIT
+} ParallelMode;
+
+typedef unsigned long long HashKey;
+
+// the squares of every piece grouped by piece (indexed by piece - B_KING), and where each square sits in its group
+typedef struct {
+    unsigned char squares[13][16];
+    unsigned char count[13];
+    unsigned char index[BOARD_SIZE*BOARD_SIZE];
+} PieceLists;
+
+// per color and square: how many pieces attack it, in total and of each kind from the cheapest (pawn) to the king
+typedef struct {
+    unsigned char count[2][BOARD_SIZE*BOARD_SIZE];
+    unsigned char by_kind[2][6][BOARD_SIZE*BOARD_SIZE];
+} AttackTables;
+
+// the part of the game state that a move changes during search, small enough to be copied instead of undone
+typedef struct {
+    char board[MAILBOX_SIZE];
+    bool whites_turn;
+    bool white_castling, black_castling;
+    HashKey piece_key;
+    float evaluation;
+    PieceLists piece_lists;
+#ifdef ATTACK_TABLES
+    AttackTables attacks;
+#endif
+} BoardState;
+
+// a position reduced to what static evaluation needs, for evaluating large sets of positions without a Chess object each
+typedef struct {
+    unsigned int ranks[BOARD_SIZE];        // 4 bits per square holding piece - B_KING, file a in the lowest bits, rank 8 first
+    bool whites_turn;
+} PackedPosition;
+
+// a packed position together with the castling rights and a possible en passant capture, all a game needs to go on
+typedef struct {
+    PackedPosition position;
+    bool castling[2];               // by color
+    signed char en_passant;         // file of a pawn that has just made a double step and can be captured, or -1
+} CompactPosition;
+
+// a move as a session stores it: from square | to square << 6, squares numbered y*BOARD_SIZE + x; pawns promote to queens
+typedef unsigned short PackedMove;
+
+const std::string STARTING_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
 const char STARTING_BOARD[BOARD_SIZE][BOARD_SIZE] = {
     {B_ROOK, B_KNIGHT, B_BISHOP, B_QUEEN, B_KING, B_BISHOP, B_KNIGHT, B_ROOK},
     {B_PAWN, B_PAWN, B_PAWN, B_PAWN, B_PAWN, B_PAWN, B_PAWN, B_PAWN},
@@ -55,6 +177,62 @@ const char STARTING_BOARD[BOARD_SIZE][BOARD_SIZE] = {
     {W_ROOK, W_KNIGHT, W_BISHOP, W_QUEEN, W_KING, W_BISHOP, W_KNIGHT, W_ROOK}
 };
 
+// piece-square bonuses from white's point of view, indexed by [piece-1][y][x]
+const float PIECE_POS_POINTS[6][BOARD_SIZE][BOARD_SIZE] =
+    {{{-3.0, -4.0, -4.0, -5.0, -5.0, -4.0, -4.0, -3.0},
+    {-3.0, -4.0, -4.0, -5.0, -5.0, -4.0, -4.0, -3.0},
+    {-3.0, -4.0, -4.0, -5.0, -5.0, -4.0, -4.0, -3.0},
+    {-3.0, -4.0, -4.0, -5.0, -5.0, -4.0, -4.0, -3.0},
+    {-2.0, -3.0, -3.0, -4.0, -4.0, -3.0, -3.0, -2.0},
+    {-1.0, -2.0, -2.0, -2.0, -2.0, -2.0, -2.0, -1.0},
+    {2.0, 2.0, 0.0, 0.0, 0.0, 0.0, 2.0, 2.0},
+    {2.0, 3.0, 1.0, 0.0, 0.0, 1.0, 3.0, 2.0}}
+    ,
+    {{-2.0, -1.0, -1.0, -0.5, -0.5, -1.0, -1.0, -2.0},
+    {-1.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, -1.0},
+    {-1.0, 0.0, 0.5, 0.5, 0.5, 0.5, 0.0, -1.0},
+    {-0.5, 0.0, 0.5, 0.5, 0.5, 0.5, 0.0, -0.5},
+    {0.0, 0.0, 0.5, 0.5, 0.5, 0.5, 0.0, -0.5},
+    {-1.0, 0.5, 0.5, 0.5, 0.5, 0.5, 0.0, -1.0},
+    {-1.0, 0.0, 0.5, 0.0, 0.0, 0.0, 0.0, -1.0},
+    {-2.0, -1.0, -1.0, -0.5, -0.5, -1.0, -1.0, -2.0}}
+    ,
+    {{-2.0, -1.0, -1.0, -1.0, -1.0, -1.0, -1.0, -2.0},
+    {-1.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, -1.0},
+    {-1.0, 0.0, 0.5, 1.0, 1.0, 0.5, 0.0, -1.0},
+    {-1.0, 0.5, 0.5, 1.0, 1.0, 0.5, 0.5, -1.0},
+    {-1.0, 0.0, 1.0, 1.0, 1.0, 1.0, 0.0, -1.0},
+    {-1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, -1.0},
+    {-1.0, 0.5, 0.0, 0.0, 0.0, 0.0, 0.5, -1.0},
+    {-2.0, -1.0, -1.0, -1.0, -1.0, -1.0, -1.0, -2.0}}
+    ,
+    {{-5.0, -4.0, -3.0, -3.0, -3.0, -3.0, -4.0, -5.0},
+    {-4.0, -2.0, 0.0, 0.0, 0.0, 0.0, -2.0, -4.0},
+    {-3.0, 0.0, 1.0, 1.5, 1.5, 1.0, 0.0, -3.0},
+    {-3.0, 0.5, 1.5, 2.0, 2.0, 1.5, 0.5, -3.0},
+    {-3.0, 0.0, 1.5, 2.0, 2.0, 1.5, 0.0, -3.0},
+    {-3.0, 0.5, 1.0, 1.5, 1.5, 1.0, 0.5, -3.0},
+    {-4.0, -2.0, 0.0, 0.5, 0.5, 0.0, -2.0, -4.0},
+    {-5.0, -4.0, -3.0, -3.0, -3.0, -3.0, -4.0, -5.0}}
+    ,
+    {{0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0},
+    {0.5, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 0.5},
+    {-0.5, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, -0.5},
+    {-0.5, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, -0.5},
+    {-0.5, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, -0.5},
+    {-0.5, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, -0.5},
+    {-0.5, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, -0.5},
+    {0.0, 0.0, 0.0, 0.5, 0.5, 0.0, 0.0, 0.0}}
+    ,
+    {{0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0},
+    {5.0, 5.0, 5.0, 5.0, 5.0, 5.0, 5.0, 5.0},
+    {1.0, 1.0, 2.0, 3.0, 3.0, 2.0, 1.0, 1.0},
+    {0.5, 0.5, 1.0, 2.5, 2.5, 1.0, 0.5, 0.5},
+    {0.0, 0.0, 0.0, 2.0, 2.0, 0.0, 0.0, 0.0},
+    {0.5, -0.5, -1.0, 0.0, 0.0, -1.0, -0.5, 0.5},
+    {0.5, 1.0, 1.0, -2.0, -2.0, 1.0, 1.0, 0.5},
+    {0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0}}};
+
 // --- Utility Functions ---
 #ifdef _WIN32
 void MoveCursorToXY(const short &x, const short &y) noexcept {
@@ -89,15 +267,188 @@ int getch() {
 }
 #endif
 
+// compile-time color helpers, so that side-dependent constants are folded inside the templated generators
+constexpr Color Opposite(const Color &c) noexcept {
+    return c == WHITE ? BLACK : WHITE;
+}
+
+// returns the piece of the given color, e.g. MakePiece<BLACK>(W_ROOK) -> B_ROOK
+template<Color C> constexpr char MakePiece(const char &white_piece) noexcept {
+    return C == WHITE ? white_piece : white_piece - 7;
+}
+
+template<Color C> constexpr bool IsOwnPiece(const char &piece) noexcept {
+    return C == WHITE ? piece > EMPTY && piece < OFF_BOARD : piece < EMPTY;
+}
+
+template<Color C> constexpr bool IsOpponentPiece(const char &piece) noexcept {
+    return IsOwnPiece<Opposite(C)>(piece);
+}
+
+// The board is stored as 10x12 squares: the 8x8 board framed by one file of OFF_BOARD squares on either side and two
+// ranks above and below, so that any step from a board square, a knight's included, stays inside the array and
+// running off the board is detected by a single compare.
+constexpr short Mailbox(const short &x, const short &y) noexcept {
+    return (y+2)*MAILBOX_WIDTH + x+1;
+}
+
+constexpr short MailboxX(const short &square) noexcept {
+    return square % MAILBOX_WIDTH - 1;
+}
+
+constexpr short MailboxY(const short &square) noexcept {
+    return square / MAILBOX_WIDTH - 2;
+}
+
+constexpr short MailboxToSquare(const short &square) noexcept {
+    return MailboxY(square)*BOARD_SIZE + MailboxX(square);
+}
+
+// mailbox steps of the sliding pieces; the order matches the ray scans they replaced
+constexpr short ROOK_DIRECTIONS[4] = {1, -1, MAILBOX_WIDTH, -MAILBOX_WIDTH};
+constexpr short BISHOP_DIRECTIONS[4] = {-MAILBOX_WIDTH-1, MAILBOX_WIDTH-1, -MAILBOX_WIDTH+1, MAILBOX_WIDTH+1};
+
 template<class T> T GetRandomNumber(const T &min, const T &max) noexcept {
     return min + T(static_cast<double>(rand()) / static_cast<double>(RAND_MAX+1.0) * (max-min+1));
 }
 
+// --- Precomputed Tables ---
+// Squares are numbered y*BOARD_SIZE + x (a8 = 0, h1 = 63) and a set of squares is a 64-bit mask.
+// All tables are generated at compile time, so nothing has to be initialized at startup.
+typedef unsigned long long Bitboard;
+typedef std::array<Bitboard, BOARD_SIZE*BOARD_SIZE> SquareTable;
+
+constexpr short KNIGHT_STEPS[8][2] = {{-2, -1}, {2, -1}, {-2, 1}, {2, 1}, {-1, -2}, {1, -2}, {-1, 2}, {1, 2}};
+constexpr short KING_STEPS[8][2] = {{-1, -1}, {0, -1}, {1, -1}, {-1, 0}, {1, 0}, {-1, 1}, {0, 1}, {1, 1}};
+// the first four are the rook directions, the last four the bishop directions
+constexpr short RAY_STEPS[8][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}, {1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+
+constexpr Bitboard SquareBB(const short &x, const short &y) noexcept {
+    return (x>=0 && x<BOARD_SIZE && y>=0 && y<BOARD_SIZE) ? 1ULL << (y*BOARD_SIZE + x) : 0;
+}
+
+constexpr SquareTable GenerateStepTable(const short (&steps)[8][2]) noexcept {
+    SquareTable table{};
+    for(short sq=0;sq<BOARD_SIZE*BOARD_SIZE;++sq)
+        for(const auto &step : steps)
+            table[sq] |= SquareBB(sq%BOARD_SIZE + step[0], sq/BOARD_SIZE + step[1]);
+    return table;
+}
+
+// squares attacked by a pawn of the given color standing on each square
+constexpr SquareTable GeneratePawnTable(const Color &c) noexcept {
+    SquareTable table{};
+    for(short sq=0;sq<BOARD_SIZE*BOARD_SIZE;++sq)
+        table[sq] = SquareBB(sq%BOARD_SIZE - 1, sq/BOARD_SIZE + (c == WHITE ? -1 : 1)) | SquareBB(sq%BOARD_SIZE + 1, sq/BOARD_SIZE + (c == WHITE ? -1 : 1));
+    return table;
+}
+
+// squares from each square to the edge of the board in the given direction, the square itself excluded
+constexpr SquareTable GenerateRayTable(const short &dx, const short &dy) noexcept {
+    SquareTable table{};
+    for(short sq=0;sq<BOARD_SIZE*BOARD_SIZE;++sq)
+        for(short x=sq%BOARD_SIZE+dx, y=sq/BOARD_SIZE+dy; SquareBB(x, y); x+=dx, y+=dy)
+            table[sq] |= SquareBB(x, y);
+    return table;
+}
+
+// for aligned squares: the squares strictly between them, or the whole line through both; zero otherwise
+constexpr std::array<SquareTable, BOARD_SIZE*BOARD_SIZE> GenerateAlignedTable(const bool &whole_line) noexcept {
+    std::array<SquareTable, BOARD_SIZE*BOARD_SIZE> table{};
+    for(short sq=0;sq<BOARD_SIZE*BOARD_SIZE;++sq)
+        for(const auto &step : RAY_STEPS) {
+            Bitboard line = 1ULL << sq, between = 0;
+            for(short x=sq%BOARD_SIZE+step[0], y=sq/BOARD_SIZE+step[1]; SquareBB(x, y); x+=step[0], y+=step[1])
+                line |= SquareBB(x, y);
+            for(short x=sq%BOARD_SIZE-step[0], y=sq/BOARD_SIZE-step[1]; SquareBB(x, y); x-=step[0], y-=step[1])
+                line |= SquareBB(x, y);
+            for(short x=sq%BOARD_SIZE+step[0], y=sq/BOARD_SIZE+step[1]; SquareBB(x, y); x+=step[0], y+=step[1]) {
+                table[sq][y*BOARD_SIZE + x] = whole_line ? line : between;
+                between |= SquareBB(x, y);
+            }
+        }
+    return table;
+}
+
+constexpr std::array<std::array<unsigned char, BOARD_SIZE*BOARD_SIZE>, BOARD_SIZE*BOARD_SIZE> GenerateDistanceTable() noexcept {
+    std::array<std::array<unsigned char, BOARD_SIZE*BOARD_SIZE>, BOARD_SIZE*BOARD_SIZE> table{};
+    for(short sq1=0;sq1<BOARD_SIZE*BOARD_SIZE;++sq1)
+        for(short sq2=0;sq2<BOARD_SIZE*BOARD_SIZE;++sq2) {
+            const short &dx = sq1%BOARD_SIZE - sq2%BOARD_SIZE, &dy = sq1/BOARD_SIZE - sq2/BOARD_SIZE;
+            table[sq1][sq2] = std::max(dx < 0 ? -dx : dx, dy < 0 ? -dy : dy);
+        }
+    return table;
+}
+
+constexpr SquareTable KNIGHT_ATTACKS = GenerateStepTable(KNIGHT_STEPS);
+constexpr SquareTable KING_ATTACKS = GenerateStepTable(KING_STEPS);
+constexpr SquareTable PAWN_ATTACKS[2] = {GeneratePawnTable(BLACK), GeneratePawnTable(WHITE)};
+constexpr SquareTable RAYS[8] = {
+    GenerateRayTable(RAY_STEPS[0][0], RAY_STEPS[0][1]), GenerateRayTable(RAY_STEPS[1][0], RAY_STEPS[1][1]),
+    GenerateRayTable(RAY_STEPS[2][0], RAY_STEPS[2][1]), GenerateRayTable(RAY_STEPS[3][0], RAY_STEPS[3][1]),
+    GenerateRayTable(RAY_STEPS[4][0], RAY_STEPS[4][1]), GenerateRayTable(RAY_STEPS[5][0], RAY_STEPS[5][1]),
+    GenerateRayTable(RAY_STEPS[6][0], RAY_STEPS[6][1]), GenerateRayTable(RAY_STEPS[7][0], RAY_STEPS[7][1])
+};
+constexpr std::array<SquareTable, BOARD_SIZE*BOARD_SIZE> BETWEEN = GenerateAlignedTable(false);
+constexpr std::array<SquareTable, BOARD_SIZE*BOARD_SIZE> LINE = GenerateAlignedTable(true);
+constexpr std::array<std::array<unsigned char, BOARD_SIZE*BOARD_SIZE>, BOARD_SIZE*BOARD_SIZE> DISTANCE = GenerateDistanceTable();
+
+// Zobrist keys, drawn at compile time from a fixed-seed splitmix64 sequence; EMPTY squares have no key
+typedef struct {
+    HashKey pieces[13][BOARD_SIZE*BOARD_SIZE];
+    HashKey side;
+    HashKey castling[2];
+    HashKey en_passant[BOARD_SIZE];
+    HashKey black_root;        // marks search results scored for black at the root
+} ZobristKeys;
+
+constexpr HashKey NextRandomKey(HashKey &state) noexcept {
+    HashKey z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+constexpr ZobristKeys GenerateZobristKeys() noexcept {
+    ZobristKeys keys{};
+    HashKey state = 0x43686573734B6579ULL;
+    for(short piece=B_KING;piece<=W_PAWN;++piece)
+        for(short sq=0;sq<BOARD_SIZE*BOARD_SIZE;++sq)
+            keys.pieces[piece - B_KING][sq] = piece == EMPTY ? 0 : NextRandomKey(state);
+    keys.side = NextRandomKey(state);
+    keys.castling[BLACK] = NextRandomKey(state), keys.castling[WHITE] = NextRandomKey(state);
+    for(short x=0;x<BOARD_SIZE;++x)
+        keys.en_passant[x] = NextRandomKey(state);
+    keys.black_root = NextRandomKey(state);
+    return keys;
+}
+
+constexpr ZobristKeys ZOBRIST = GenerateZobristKeys();
+
+// returns the index of the lowest set square and removes it from the mask
+inline short PopLsb(Bitboard &b) noexcept {
+    const short index = __builtin_ctzll(b);
+    b &= b - 1;
+    return index;
+}
+
+// attackers ordered by value: the kind of each white piece, and the white piece of each kind
+constexpr short ATTACKER_KIND[7] = {-1, 5, 4, 2, 1, 3, 0};
+constexpr char KIND_PIECE[6] = {W_PAWN, W_KNIGHT, W_BISHOP, W_ROOK, W_QUEEN, W_KING};
+
 // --- Forward Declarations ---
 class Chess;
 class Player;
+class TimeManager;
+class SearchTable;
+class SearchThread;
+class ParallelSearch;
 class PathNode;
 class Bot;
+class PerftTable;
+class SessionManager;
+class AnalysisCache;
+class SearchServer;
 
 // --- Player Class ---
 class Player {
@@ -116,37 +467,230 @@ public:
     bool operator== (const Player &p) const noexcept { return !name.compare(p.name); }
 };
 
+// --- TimeManager Class ---
+// the clock as a UCI "go" command gives it, in milliseconds
+typedef struct {
+    long long white_time, black_time, white_increment, black_increment;
+    unsigned short moves_to_go;        // 0 if the remaining time is for the rest of the game
+} GameClock;
+
+// Decides how long a search may run. Without a clock it never stops one. With a clock it derives a soft limit, checked
+// after every iteration and scaled by how settled the search looks, and a hard limit that aborts a running iteration.
+class TimeManager {
+private:
+    std::chrono::steady_clock::time_point start;
+    double soft_limit = 0, hard_limit = 0;        // seconds, 0 without a clock
+    double iteration_end = 0, iteration_time = 0;
+    std::vector<float> best_scores;               // best score of every finished iteration
+    bool stopped = false;
+    const std::atomic<bool> *stop_signal = nullptr;        // set by another thread to end the search early
+public:
+    void Start() noexcept;
+    void Start(const GameClock &clock, const bool &white) noexcept;
+    void Start(const double &move_time) noexcept;
+    double Elapsed() const noexcept;
+    double GetSoftLimit() const noexcept { return soft_limit; }
+    double GetHardLimit() const noexcept { return hard_limit; }
+    bool Stopped() const noexcept { return stopped; }
+    void SetStopSignal(const std::atomic<bool> *signal) noexcept { stop_signal = signal; }
+    bool ShouldStop(const unsigned long long &nodes) noexcept;
+    bool NextIteration(const float &best_score, const float &runner_up_score, const size_t &root_moves, const unsigned short &best_move_stability) noexcept;
+};
+
+// --- SearchTable Class ---
+// what one thread did with the shared table; shared hits and replacements concern entries written by other threads
+typedef struct {
+    unsigned long long probes, hits, shared_hits, stores, replacements;
+} TableStats;
+
+// Lock-free table of search results shared by the threads of a parallel search, entries verified like PerftTable ones.
+// Scores are seen from the side to move at the root, which is part of the key.
+class SearchTable {
+private:
+    typedef struct {
+        std::atomic<unsigned long long> key, data;
+    } Entry;
+    std::vector<Entry> entries;
+public:
+    SearchTable(const size_t &megabytes) noexcept;
+    bool Probe(const HashKey &key, const unsigned short &depth, const float &alpha, const float &beta, float &score, const unsigned short &thread, TableStats &stats) const noexcept;
+    void Store(const HashKey &key, const unsigned short &depth, const float &score, const Bound &bound, const unsigned short &thread, TableStats &stats) noexcept;
+};
+
+// --- SearchThread Class ---
+// a node whose younger brothers are searched by all threads that are idle once its eldest brother has been searched
+typedef struct SplitPoint {
+    std::mutex mutex;                         // guards alpha, beta and points
+    const SplitPoint *parent;                 // split point its owner was working under
+    std::vector<std::string> path;            // moves from the root to the node
+    unsigned short depth;
+    float alpha, beta, points;
+    bool maximizing_player, initial_turn;
+    std::atomic<bool> cutoff;
+    std::atomic<size_t> pending;              // younger brothers not searched yet
+} SplitPoint;
+
+typedef struct {
+    SplitPoint *split_point;
+    std::string move;
+} SplitTask;
+
+// What a thread of a search carries down the tree besides its board: the clock, the parallel search it belongs to (none
+// for a single-threaded search), and the moves and split point that led it to the node it is searching.
+class SearchThread {
+private:
+    ParallelSearch *search;
+    unsigned short index;                     // 0 for the thread whose result is played
+    TimeManager &time_manager;
+    SplitPoint *split_point = nullptr;
+    std::vector<std::string> path;
+    TableStats stats = {};
+    friend class ParallelSearch;
+public:
+    SearchThread(ParallelSearch *search, const unsigned short &index, TimeManager &time_manager) noexcept : search(search), index(index), time_manager(time_manager) {}
+    unsigned short GetIndex() const noexcept { return index; }
+    TimeManager& GetTimeManager() noexcept { return time_manager; }
+    bool HasTable() const noexcept { return search; }
+    bool ProbeTable(const HashKey &key, const unsigned short &depth, const float &alpha, const float &beta, float &score) noexcept;
+    void StoreTable(const HashKey &key, const unsigned short &depth, const float &score, const Bound &bound) noexcept;
+    bool ShouldStop(const unsigned long long &nodes) noexcept;
+    bool Stopped() const noexcept;
+    void Enter(const std::string &move) noexcept { if(search) path.push_back(move); }
+    void Leave() noexcept { if(search) path.pop_back(); }
+    void GoTo(Chess &c, const std::vector<std::string> &target) noexcept;
+    bool CanSplit(const unsigned short &depth) const noexcept;
+    float Split(Chess &c, const std::vector<std::string> &moves, const unsigned short &depth, const float &alpha, const float &beta, const bool &maximizing_player, const bool &initial_turn, const float &points) noexcept;
+};
+
+// --- ParallelSearch Class ---
+// Searches with several threads that share a SearchTable. With LAZY_SMP every thread runs its own iterative deepening
+// and they only meet in the table. With YOUNG_BROTHERS_WAIT only the first thread does, and a node splits once its first
+// move has been searched: the other moves go to the thread's work queue, idle threads steal them from the front, and a
+// cutoff found by any of them stops all threads working below the split point.
+class ParallelSearch {
+private:
+    typedef struct {
+        std::mutex mutex;
+        std::deque<SplitTask> tasks;          // the owner works from the back, thieves from the front
+        std::atomic<size_t> size{0};
+    } WorkQueue;
+    ParallelMode mode;
+    unsigned short threads;
+    SearchTable table;
+    std::vector<WorkQueue> queues;
+    std::atomic<bool> stop{false};
+    std::atomic<unsigned short> idle_threads{0};
+    unsigned long long nodes = 0;             // searched by all threads in the last search
+    TableStats table_stats = {};              // of all threads in the last search
+    bool NextTask(const unsigned short &index, SplitTask &task) noexcept;
+    void Execute(Chess &c, SearchThread &thread, const SplitTask &task) noexcept;
+    void Help(Chess &c, SearchThread &thread) noexcept;
+public:
+    ParallelSearch(const unsigned short &threads, const ParallelMode &mode, const size_t &hash_megabytes) noexcept;
+    ParallelMode GetMode() const noexcept { return mode; }
+    unsigned short GetThreads() const noexcept { return threads; }
+    unsigned long long GetNodes() const noexcept { return nodes; }
+    const TableStats& GetTableStats() const noexcept { return table_stats; }
+    SearchTable& GetTable() noexcept { return table; }
+    bool Stopped() const noexcept { return stop.load(std::memory_order_relaxed); }
+    void Stop() noexcept { stop.store(true, std::memory_order_relaxed); }
+    bool WantsSplit(const unsigned short &depth) const noexcept;
+    float Split(Chess &c, SearchThread &thread, const std::vector<std::string> &moves, const unsigned short &depth, const float &alpha, const float &beta, const bool &maximizing_player, const bool &initial_turn, const float &points) noexcept;
+    std::string Search(Chess &c, PathNode &root, unsigned short &difficulty, TimeManager &time_manager) noexcept;
+};
+
 // --- PathNode Class ---
+// a root move with what the last iteration of the search found out about it
+typedef struct {
+    std::string move;                // in real coordinates
+    float score;                     // exact for the best moves, an upper bound for the others
+    unsigned long long nodes;        // size of its subtree
+} RootMove;
+
 class PathNode {
 private:
     std::map<std::string, PathNode> child_node_list;
+    std::vector<RootMove> root_moves;
+    std::vector<std::string> best_moves;        // all moves sharing the best score in the last completed iteration
+    unsigned short best_move_stability = 0;
+    unsigned short completed_depth = 0;
     void CreateSubtree(Chess &c) noexcept;
-    float AlphaBeta(Chess &c, unsigned short &depth, float alpha, float beta, const bool &maximizing_player, const bool &initial_turn) noexcept;
+    float AlphaBeta(Chess &c, unsigned short &depth, float alpha, float beta, const bool &maximizing_player, const bool &initial_turn, SearchThread &thread) noexcept;
+    friend class ParallelSearch;
 public:
-    std::string AlphaBetaRoot(Chess &c, unsigned short &difficulty) noexcept;
+    std::string AlphaBetaRoot(Chess &c, unsigned short &difficulty, SearchThread &thread) noexcept;
+    unsigned short GetCompletedDepth() const noexcept { return completed_depth; }
+    const std::vector<RootMove>& GetRootMoves() const noexcept { return root_moves; }
+    const std::vector<std::string>& GetBestMoves() const noexcept { return best_moves; }
+    unsigned short GetBestMoveStability() const noexcept { return best_move_stability; }
 };
 
 // --- Bot Class ---
+// the outcome of a finished root search, enough to answer the same position again without searching
+typedef struct {
+    HashKey key;                            // Chess::GetSearchKey of the position, 0 for an unused entry
+    unsigned short depth;                   // depth of the last completed iteration
+    std::vector<std::string> best_moves;
+} RootResult;
+
 class Bot : public Player {
 private:
     PathNode root;
+    TimeManager time_manager;
     unsigned short difficulty;
+    std::vector<RootResult> root_results;                  // direct-mapped, allocated by the first search
+    unsigned short timed_depth = MAX_SEARCH_DEPTH;         // depth reached by the last timed search
+    std::shared_ptr<ParallelSearch> parallel_search;       // nullptr for a single thread, shared by copies of the bot
+    bool ProbeRootResult(const HashKey &key, const unsigned short &depth, std::string &move) const noexcept;
+    void StoreRootResult(const HashKey &key) noexcept;
+    std::string Search(Chess &c, unsigned short &depth) noexcept;
 public:
     Bot(const std::string &name, const unsigned short &difficulty) noexcept : Player(name), difficulty(difficulty) {}
     unsigned short GetDifficulty() const noexcept { return difficulty; }
-    std::string GetIdealMove(Chess &c) noexcept { return root.AlphaBetaRoot(c, difficulty); }
-    std::string GetIdealMove(Chess &c, unsigned short difficulty) noexcept { return root.AlphaBetaRoot(c, difficulty); }
+    const PathNode& GetSearch() const noexcept { return root; }
+    const TimeManager& GetTimeManager() const noexcept { return time_manager; }
+    const ParallelSearch* GetParallelSearch() const noexcept { return parallel_search.get(); }
+    void SetThreads(const unsigned short &threads, const ParallelMode &mode) noexcept;
+    void SetStopSignal(const std::atomic<bool> *signal) noexcept { time_manager.SetStopSignal(signal); }
+    std::string GetIdealMove(Chess &c) noexcept { return GetIdealMove(c, difficulty); }
+    std::string GetIdealMove(Chess &c, unsigned short difficulty) noexcept;
+    std::string GetIdealMove(Chess &c, const GameClock &clock, unsigned short depth = MAX_SEARCH_DEPTH) noexcept;
     bool operator== (const Bot &b) const noexcept { return !name.compare(b.name); }
 };
 
+// --- PerftTable Class ---
+// Lock-free cache of perft subtree sizes shared by all perft threads. Every entry stores its key XORed with its data,
+// so an entry torn by concurrent writes fails verification and is treated as a miss.
+class PerftTable {
+private:
+    typedef struct {
+        std::atomic<unsigned long long> key, data;
+    } Entry;
+    std::vector<Entry> entries;
+    static size_t Index(const HashKey &key, const unsigned short &depth, const size_t &size) noexcept;
+public:
+    PerftTable(const size_t &megabytes) noexcept;
+    bool Probe(const HashKey &key, const unsigned short &depth, unsigned long long &leaf_nodes) const noexcept;
+    void Store(const HashKey &key, const unsigned short &depth, const unsigned long long &leaf_nodes) noexcept;
+};
+
 // --- Chess Class Declaration (Implementation Follows) ---
 class Chess {
 private:
-    char board[BOARD_SIZE][BOARD_SIZE];
+    char board[MAILBOX_SIZE];
     Bot white, black;
     std::vector<std::pair<Moves, std::string>> all_game_moves;
+    std::vector<HashKey> position_keys;        // key of the position before each move in all_game_moves
     bool whites_turn = true;
     unsigned short moves_after_last_pawn_move_or_capture = 0;
+    unsigned long long nodes = 0;
+    HashKey piece_key = 0;
+    float evaluation = 0;                         // the sum of EVALUATION_TABLE over the pieces on the board, kept up by SetPiece
+    PieceLists piece_lists = {};
+#ifdef ATTACK_TABLES
+    AttackTables attacks = {};
+#endif
+    bool start_castling[2] = {true, true};        // castling rights before the first move in all_game_moves, by color
     bool white_bot_random;
     bool black_bot_random;
     static bool WithinBounds(const short &coord) noexcept;
@@ -154,53 +698,304 @@ private:
     static std::string ToString(const short &x1, const short &y1, const short &x2, const short &y2) noexcept;
     static std::string PieceNameToString(const char &piece) noexcept;
     static float EvaluatePiece(const char &piece) noexcept;
+    static const std::array<std::array<float, BOARD_SIZE*BOARD_SIZE>, 13> EVALUATION_TABLE;
+    static std::array<std::array<float, BOARD_SIZE*BOARD_SIZE>, 13> GenerateEvaluationTable() noexcept;
     static void ClearAllMoves(const unsigned short &n) noexcept;
     static void PrintSeparator(const char &ch) noexcept;
-    static void CopyBoard(const char from[BOARD_SIZE][BOARD_SIZE], char to[BOARD_SIZE][BOARD_SIZE]) noexcept;
-    static bool AreBoardsEqual(const char board1[BOARD_SIZE][BOARD_SIZE], const char board2[BOARD_SIZE][BOARD_SIZE]) noexcept;
+    static void CopyBoard(const char from[MAILBOX_SIZE], char to[MAILBOX_SIZE]) noexcept;
     static bool CanMovePiece(const short &x1, const short &y1, const short &x2, const short &y2, const std::forward_list<std::string> &all_moves) noexcept;
     Bot& GetCurrentPlayer() noexcept;
-    Bot GetCurrentPlayerConst() const noexcept;
+    const Bot& GetCurrentPlayerConst() const noexcept;
     Bot& GetOtherPlayer() noexcept;
-    Bot GetOtherPlayerConst() const noexcept;
+    const Bot& GetOtherPlayerConst() const noexcept;
     void ChangeTurn() noexcept;
     void AppendToAllGameMoves(const short &x1, const short &y1, const short &x2, const short &y2) noexcept;
     void Reset() noexcept;
     void CheckCoordinates(const short &x, const short &y, const std::string &func_name) const noexcept(false);
     bool EndGameText(const unsigned short &n, const Endgame &end_game) const noexcept;
-    short GetEnPassant(const short &x, const short &y) const noexcept;
-    template<class Iterator> short GetEnPassant(const char board[BOARD_SIZE][BOARD_SIZE], const Iterator &it) const noexcept;
-    bool ThreefoldRepetition() const noexcept;
+    template<Color Us> short GetEnPassant(const short &x, const short &y) const noexcept;
+    char PieceOn(const short &sq) const noexcept;
+    void SetPiece(const short &x, const short &y, const char &piece) noexcept;
+    void SetUpBoard(const char new_board[BOARD_SIZE][BOARD_SIZE]) noexcept;
+#ifdef ATTACK_TABLES
+    void UpdateAttacks(const short &square, const char &piece, const short &sign) noexcept;
+    void UpdateRaysThrough(const short &square, const short &sign) noexcept;
+#endif
+    template<Color C> unsigned char PieceCount(const char &white_piece) const noexcept;
+    short GetEnPassantFile() const noexcept;
+    template<Color Us> short KingSquare() const noexcept;
+    template<Color Us> bool IsCheck() const noexcept;
     bool IsCheck(const bool &turn) const noexcept;
-    bool IsCheck(std::string &move) noexcept;
-    std::forward_list<std::string> PawnMoves(const short &x, const short &y) const noexcept;
-    std::forward_list<std::string> RookMoves(const short &x, const short &y) const noexcept;
-    std::forward_list<std::string> KnightMoves(const short &x, const short &y) const noexcept;
-    std::forward_list<std::string> BishopMoves(const short &x, const short &y) const noexcept;
-    std::forward_list<std::string> QueenMoves(const short &x, const short &y) const noexcept;
-    std::forward_list<std::string> KingMoves(const short &x, const short &y) const noexcept;
+    template<Color Us> bool IsCheck(std::string &move) noexcept;
+    template<Color Us> bool NeedsLegalityTest(const std::string &move, const short &king) const noexcept;
+    template<Color Us, GenType Type> void AddMove(const short &x1, const short &y1, const short &x2, const short &y2, std::forward_list<std::string> &all_moves) const noexcept;
+    template<Color Us, GenType Type> void AddSlidingMoves(const short &x, const short &y, const short &step, std::forward_list<std::string> &all_moves) const noexcept;
+    template<Color Us, GenType Type> std::forward_list<std::string> PawnMoves(const short &x, const short &y) const noexcept;
+    template<Color Us, GenType Type> std::forward_list<std::string> RookMoves(const short &x, const short &y) const noexcept;
+    template<Color Us, GenType Type> std::forward_list<std::string> KnightMoves(const short &x, const short &y) const noexcept;
+    template<Color Us, GenType Type> std::forward_list<std::string> BishopMoves(const short &x, const short &y) const noexcept;
+    template<Color Us, GenType Type> std::forward_list<std::string> QueenMoves(const short &x, const short &y) const noexcept;
+    template<Color Us, GenType Type> std::forward_list<std::string> KingMoves(const short &x, const short &y) const noexcept;
+    template<Color Us, GenType Type> std::forward_list<std::string> PieceMoves(const short &x, const short &y) const noexcept;
+    template<Color Us, GenType Type> std::forward_list<std::string> GenerateMoves() noexcept;
+    template<Color Us, GenType Type> bool HasLegalMove() noexcept;
     std::string GetRandomMove() noexcept;
     void ManuallyPromotePawn(const short &x, const short &y) noexcept;
     void UpdateBoard(const short &x, const short &y) const noexcept;
     void UpdateScore(const Bot &p) const noexcept;
-    float EvaluatePosition(const short &x, const short &y) const noexcept;
+    template<Color Us> float EvaluateBoard() const noexcept;
+    template<Color Us> short ScoreMove(const std::string &move, const Bitboard &occupied) const noexcept;
     void PrintAllMovesMadeInOrder() const noexcept;
     bool CheckEndgame(const unsigned short &n = 0) noexcept;
+    bool CouldCastleBeforeLastMove() const noexcept;
+    static bool IsIrreversible(const std::pair<Moves, std::string> &game_move) noexcept;
+    void LoadPosition(const char new_board[BOARD_SIZE][BOARD_SIZE], const bool &white_to_move, const bool castling[2], const short &en_passant) noexcept;
 public:
     Chess(const std::string &player1, const unsigned short &difficulty1, const std::string &player2, const unsigned short &difficulty2, bool white_bot_random = false, bool black_bot_random = false) noexcept;
     static void ChangeToRealCoordinates(char &x1, char &y1, char &x2, char &y2) noexcept;
+    static std::string ToCoordinateString(const std::string &move) noexcept;
     char GetPiece(const short &x, const short &y) const noexcept;
     bool GetTurn() const noexcept;
     std::forward_list<std::string> AllMoves() noexcept;
+    template<GenType Type> std::forward_list<std::string> AllMoves() noexcept;
+    bool HasLegalMove() noexcept;
+    bool IsCheck() const noexcept;
+    bool IsInsufficientMaterial() const noexcept;
+    Bitboard Occupancy() const noexcept;
+    template<Color By> unsigned char ScanAttackers(const short &sq, const Bitboard &occupied, char &least_valuable) const noexcept;
+#ifdef ATTACK_TABLES
+    template<Color By> unsigned char AttackCount(const short &sq) const noexcept;
+    template<Color By> char LeastValuableAttacker(const short &sq) const noexcept;
+#endif
+    unsigned short RepetitionCount() const noexcept;
     void MovePiece(const short &x1, const short &y1, const short &x2, const short &y2, const bool &manual_promotion, const bool &update_board) noexcept;
     void MovePieceBack(const short &x1, const short &y1, const short &x2, const short &y2) noexcept;
+    BoardState GetState() const noexcept;
+    void MovePieceBack(const BoardState &state) noexcept;
+    bool PlayMove(std::string move) noexcept;
+    bool SetPosition(const std::string &fen) noexcept;
+    void SetPosition(const CompactPosition &position) noexcept;
+    CompactPosition GetCompactPosition() const noexcept;
+    bool LastMoveWasIrreversible() const noexcept;
+    HashKey GetKey() const noexcept;
+    HashKey GetSearchKey() const noexcept;
+    unsigned long long Perft(const unsigned short &depth, PerftTable *table = nullptr) noexcept;
+    unsigned long long GetNodes() const noexcept;
+    void IncreaseNodes() noexcept;
+    void ResetNodes() noexcept;
     float EvaluateBoard(const bool &turn) const noexcept;
+    short ScoreMove(const std::string &move, const Bitboard &occupied) const noexcept;
+    static float EvaluateSquares(const char *first_rank, const short &rank_stride) noexcept;
+    float EvaluateAllSquares(const bool &turn) const noexcept;
+    PackedPosition Pack() const noexcept;
+    static void EvaluateBatch(const PackedPosition *positions, const size_t &count, float *evaluations) noexcept;
+    static void EvaluatePositions(const PackedPosition *positions, const size_t &count, float *evaluations, const unsigned short &threads = 1) noexcept;
     void PrintBoard() const noexcept;
     bool PlayersTurn() noexcept;
     bool BotsTurn() noexcept;
     bool GameOver() noexcept;
 };
 
+// --- SessionManager Class ---
+typedef unsigned long long SessionId;
+
+typedef enum {
+    SESSION_OK, SESSION_UNKNOWN, SESSION_BUSY, SESSION_FULL, SESSION_ILLEGAL_MOVE, SESSION_NOT_YOUR_TURN, SESSION_OVER,
+    SESSION_STORE_FAILED        // a suspended session could not be read back
+} SessionStatus;
+
+typedef struct {
+    unsigned long long suspends, resumes, compactions;
+    long long bytes;            // size of the store file
+} StoreStats;
+
+// Hosts many human-vs-bot games at once, each kept as a fixed-size record: the position after the last irreversible
+// move, the moves played since and the clock. A Chess object is set up from the record only while a call checks or
+// searches a move, so an idle game costs the same few hundred bytes however long it gets. Calls for different sessions
+// may run on different threads at the same time; a session another call is using answers SESSION_BUSY.
+// With a store file, a game that has to make room for another one, or has been idle for long, is suspended: its record
+// is appended to the file and its slot freed, and the next call on it reads it back. Then the slots only bound the
+// games in play, and the open games are bounded by the disk. The file is rewritten without the records of resumed and
+// closed games once these make up most of it.
+class SessionManager {
+private:
+    // what a game needs to go on, written to the store as it is except for the unused moves
+    typedef struct {
+        CompactPosition base;                   // position after the last irreversible move, the starting one at first
+        unsigned char move_count;
+        GameClock clock;                        // times left in milliseconds, both 0 without a clock
+        std::chrono::steady_clock::time_point turn_start;
+        unsigned short difficulty;              // search depth of the bot without a clock
+        Color bot_color;
+        bool over;
+        Endgame result;
+        PackedMove moves[SESSION_MOVES];        // moves played since the base position
+    } GameRecord;
+    typedef struct {
+        GameRecord game;
+        SessionId id;
+        std::chrono::steady_clock::time_point last_used;
+        std::atomic<bool> busy;
+    } Session;
+    std::vector<Session> sessions;                         // the slots, allocated once so that a session never moves
+    std::vector<size_t> free_slots;
+    std::unordered_map<SessionId, size_t> resident;        // slot of every session in memory
+    std::unordered_map<SessionId, long long> suspended;    // store offset of every suspended session
+    SessionId next_id = 0;
+    std::string store_path;                                // empty without a store
+    std::fstream store;
+    unsigned long long dead_records = 0;                   // records in the store of sessions that were resumed or closed
+    StoreStats store_stats = {};
+    std::mutex mutex;                                      // guards all of the above but the sessions in use
+    SessionStatus Acquire(const SessionId &id, size_t &slot) noexcept;
+    void Release(const size_t &slot) noexcept;
+    bool FreeSlot(size_t &slot) noexcept;
+    bool Suspend(const size_t &slot) noexcept;
+    static bool ReadRecord(std::fstream &file, const long long &offset, const SessionId &id, GameRecord &game) noexcept;
+    static long long WriteRecord(std::fstream &file, const SessionId &id, const GameRecord &game) noexcept;
+    void CompactStore() noexcept;
+    static void Hydrate(const GameRecord &game, Chess &c) noexcept;
+    static bool ChargeClock(GameRecord &game, const bool &white) noexcept;
+    static void Record(GameRecord &game, Chess &c, const std::string &move) noexcept;
+public:
+    SessionManager(const size_t &max_sessions, const std::string &store_path = "") noexcept;
+    ~SessionManager() noexcept;
+    static size_t GetSessionSize() noexcept { return sizeof(Session); }
+    size_t GetOpenSessions() noexcept;
+    size_t GetSuspendedSessions() noexcept;
+    StoreStats GetStoreStats() noexcept;
+    SessionStatus Open(const Color &bot_color, const unsigned short &difficulty, const GameClock &clock, SessionId &id) noexcept;
+    SessionStatus Close(const SessionId &id) noexcept;
+    size_t SuspendIdle(const double &idle_seconds) noexcept;
+    SessionStatus GetLegalMoves(const SessionId &id, std::forward_list<std::string> &moves) noexcept;
+    SessionStatus GetResult(const SessionId &id, Endgame &result) noexcept;
+    SessionStatus PlayMove(const SessionId &id, const std::string &move) noexcept;
+    SessionStatus BotMove(const SessionId &id, std::string &move) noexcept;
+};
+
+// --- AnalysisCache Class ---
+// what an analysis found: the best move in coordinate notation ("" without a legal move), its score for the side to
+// move and the depth of the last completed iteration, MAX_SEARCH_DEPTH for a forced move
+typedef struct {
+    std::string move;
+    float score;
+    unsigned short depth;
+} AnalysisResult;
+
+// Results of finished analyses by search key, forgetting the least recently used one when full. A result answers every
+// request for its position that asks for at most its depth.
+class AnalysisCache {
+private:
+    typedef std::pair<HashKey, AnalysisResult> Entry;
+    size_t capacity;
+    std::list<Entry> entries;                                          // most recently used first
+    std::unordered_map<HashKey, std::list<Entry>::iterator> index;
+public:
+    AnalysisCache(const size_t &capacity) noexcept : capacity(capacity) {}
+    size_t GetSize() const noexcept { return entries.size(); }
+    bool Probe(const HashKey &key, const unsigned short &depth, AnalysisResult &result) noexcept;
+    void Store(const HashKey &key, const AnalysisResult &result) noexcept;
+};
+
+// --- SearchServer Class ---
+typedef enum {
+    FROM_CACHE, COALESCED, SEARCHED
+} AnalysisSource;
+
+typedef enum {
+    INTERACTIVE, BATCH
+} Priority;
+
+typedef std::function<void(const AnalysisResult &result, const AnalysisSource &source)> AnalysisCallback;
+
+typedef struct {
+    unsigned long long requests, cache_hits, coalesced, searches;        // analyses
+    unsigned long long moves, deadline_misses, preemptions;              // interactive moves, and analyses they stopped
+    unsigned long long degraded;                                         // requests given less effort than they asked for
+    unsigned short level;                                                // current degradation level
+    double latency;                                                      // seconds a search waits for a worker, on average
+} ServerStats;
+
+// How a server trades search effort for responsiveness. Every degradation level halves the time of moves and takes a
+// ply off analyses. The level goes up when either the waiting requests per worker or the average time a search waits
+// for a worker is above its high mark, and down when both are below their low marks, but changes at most once per
+// interval.
+typedef struct {
+    unsigned short max_level;                // 0 never degrades
+    double queue_high, queue_low;
+    double latency_high, latency_low;        // seconds
+    double interval;                         // seconds
+} LoadPolicy;
+
+const LoadPolicy DEFAULT_LOAD_POLICY = {3, 2.0, 0.5, 0.5, 0.1, 0.5};
+
+// an analyse or move request of the server's line protocol, see RunServer()
+typedef struct {
+    bool move;                                           // a bot move, otherwise an analysis
+    std::string id;
+    unsigned short depth;                                // of an analysis
+    long milliseconds;                                   // of a move
+    Chess position = Chess("Server1", 0, "Server2", 0);
+} ServerRequest;
+
+// Answers requests of two priority classes on a pool of worker threads, each searching one position at a time.
+// Interactive requests are bot moves that must be played by a deadline. They are taken earliest deadline first and
+// before any batch request. Batch requests are analyses to a given depth, run by at most max_batch workers at once so
+// that the other workers stay free for moves. When a move finds no worker idle, a running analysis is stopped, its
+// result so far goes to the cache, and it waits at the front of the batch queue to be searched again.
+// An analysis is answered from the cache if it can be. Otherwise it joins the search of its position that is running
+// or waiting for a worker, if there is one, so that identical requests arriving together cost a single search.
+// Callbacks run on a worker, or on the calling thread for cache hits.
+class SearchServer {
+private:
+    typedef struct {
+        unsigned short depth;                                  // after degradation
+        std::chrono::steady_clock::time_point arrival;
+        AnalysisCallback callback;
+    } Waiter;
+    // a search that is running or waiting for a worker, and the requests waiting for its result, the first of which
+    // asked for it; a move has a single request
+    typedef struct {
+        Chess position;
+        HashKey key;
+        Priority priority;
+        unsigned short depth;                                  // the deepest request's while waiting, fixed once running
+        std::chrono::steady_clock::time_point deadline;        // of a move
+        double move_time;                                      // seconds a move may take, up to the deadline
+        bool running;
+        std::vector<Waiter> waiters;
+    } Job;
+    typedef struct {
+        std::shared_ptr<Job> job;            // nullptr while idle
+        std::atomic<bool> stop;              // set to preempt the job
+    } Worker;
+    AnalysisCache cache;
+    std::unordered_map<HashKey, std::shared_ptr<Job>> analyses;        // by search key, one per position at most
+    std::vector<std::shared_ptr<Job>> moves;                           // a heap with the earliest deadline on top
+    std::deque<std::shared_ptr<Job>> batch;
+    std::vector<Worker> workers;
+    std::vector<std::thread> threads;
+    unsigned short max_batch, running_batch = 0, idle_workers = 0;
+    std::mutex mutex;
+    std::condition_variable work;
+    bool stopping = false;
+    ServerStats stats = {};
+    LoadPolicy policy;
+    std::chrono::steady_clock::time_point level_change;
+    void Work(const unsigned short &index) noexcept;
+    void Preempt() noexcept;
+    void AdjustLevel() noexcept;
+    void Started(const Job &job) noexcept;
+    static bool LaterDeadline(const std::shared_ptr<Job> &a, const std::shared_ptr<Job> &b) noexcept { return a->deadline > b->deadline; }
+    static AnalysisResult Search(Chess &c, const unsigned short &depth, TimeManager &time_manager) noexcept;
+public:
+    SearchServer(const unsigned short &threads, const unsigned short &max_batch, const size_t &cache_entries, const LoadPolicy &policy = DEFAULT_LOAD_POLICY) noexcept;
+    ~SearchServer() noexcept;
+    void Analyse(const Chess &c, const unsigned short &requested_depth, const AnalysisCallback &callback) noexcept;
+    void Move(const Chess &c, const double &seconds, const AnalysisCallback &callback) noexcept;
+    ServerStats GetStats() noexcept;
+};
+
 // --- PathNode Implementation ---
 void PathNode::CreateSubtree(Chess &c) noexcept {
     auto all_moves = c.AllMoves();
@@ -210,105 +1005,598 @@ void PathNode::CreateSubtree(Chess &c) noexcept {
     }
 }
 
-float PathNode::AlphaBeta(Chess &c, unsigned short &depth, float alpha, float beta, const bool &maximizing_player, const bool &initial_turn) noexcept {
+// Only parallel searches use a table; scores outside the window are stored as the bounds they are.
+float PathNode::AlphaBeta(Chess &c, unsigned short &depth, float alpha, float beta, const bool &maximizing_player, const bool &initial_turn, SearchThread &thread) noexcept {
+    c.IncreaseNodes();
+    if(thread.ShouldStop(c.GetNodes()))
+        return 0;
+    if(c.RepetitionCount() || c.IsInsufficientMaterial())
+        return 0;
     if(!depth)
         return c.EvaluateBoard(initial_turn);
+    const HashKey &key = thread.HasTable() ? c.GetKey() ^ (initial_turn ? 0 : ZOBRIST.black_root) : 0;
+    float points;
+    if(thread.ProbeTable(key, depth, alpha, beta, points))
+        return points;
+    const float window_alpha = alpha, window_beta = beta;
     CreateSubtree(c);
-    float points = maximizing_player ? -9999 : 9999;
-    for(auto &node : child_node_list) {
-        if(c.GetPiece(node.first[2], node.first[3]) == W_KING - 7*c.GetTurn()) {
+    if(child_node_list.empty())
+        return c.IsCheck() ? (maximizing_player ? -9999 : 9999) : 0;
+    std::vector<std::pair<short, std::map<std::string, PathNode>::iterator>> order;
+    const Bitboard &occupied = depth >= ORDERING_DEPTH ? c.Occupancy() : 0;
+    for(auto node = child_node_list.begin(); node != child_node_list.end(); ++node)
+        order.emplace_back(depth >= ORDERING_DEPTH ? c.ScoreMove(node->first, occupied) : 0, node);
+    if(depth >= ORDERING_DEPTH)
+        std::stable_sort(order.begin(), order.end(), [](const auto &a, const auto &b) { return a.first > b.first; });
+    points = maximizing_player ? -9999 : 9999;
+    for(auto next = order.begin(); next != order.end(); ++next) {
+        const auto &node = next->second;
+        const std::string &move = node->first;
+        if(c.GetPiece(move[2], move[3]) == W_KING - 7*c.GetTurn()) {
             child_node_list.clear();
             return maximizing_player ? 9999 : -9999;
         }
-        c.MovePiece(node.first[0], node.first[1], node.first[2], node.first[3], false, false);
-        points = maximizing_player ? std::max(points, node.second.AlphaBeta(c, --depth, alpha, beta, false, initial_turn))
-        : std::min(points, node.second.AlphaBeta(c, --depth, alpha, beta, true, initial_turn));
+#ifdef COPY_MAKE
+        const BoardState state = c.GetState();
+#endif
+        c.MovePiece(move[0], move[1], move[2], move[3], false, false);
+        thread.Enter(move);
+        points = maximizing_player ? std::max(points, node->second.AlphaBeta(c, --depth, alpha, beta, false, initial_turn, thread))
+        : std::min(points, node->second.AlphaBeta(c, --depth, alpha, beta, true, initial_turn, thread));
         maximizing_player ? alpha = std::max(alpha, points) : beta = std::min(beta, points);
         ++depth;
-        c.MovePieceBack(node.first[0], node.first[1], node.first[2], node.first[3]);
-        if(alpha >= beta)
+        thread.Leave();
+#ifdef COPY_MAKE
+        c.MovePieceBack(state);
+#else
+        c.MovePieceBack(move[0], move[1], move[2], move[3]);
+#endif
+        if(alpha >= beta || thread.Stopped())
             break;
+        if(std::next(next) != order.end() && thread.CanSplit(depth)) {
+            std::vector<std::string> younger_brothers;
+            for(auto brother = std::next(next); brother != order.end(); ++brother)
+                younger_brothers.emplace_back(brother->second->first);
+            points = thread.Split(c, younger_brothers, depth, alpha, beta, maximizing_player, initial_turn, points);
+            break;
+        }
     }
     child_node_list.clear();
+    if(thread.HasTable() && !thread.Stopped())
+        thread.StoreTable(key, depth, points, points <= window_alpha ? UPPER_BOUND : points >= window_beta ? LOWER_BOUND : EXACT_BOUND);
     return points;
 }
 
-std::string PathNode::AlphaBetaRoot(Chess &c, unsigned short &difficulty) noexcept {
-    CreateSubtree(c);
-    std::vector<std::string> ideal_moves;
-    float max_move_score = -9999;
-    for(auto &node : child_node_list) {
-        if(c.GetPiece(node.first[2], node.first[3]) == W_KING - 7*c.GetTurn()) {
-            child_node_list.clear();
-            return node.first;
-        }
-        c.MovePiece(node.first[0], node.first[1], node.first[2], node.first[3], false, false);
-        float move_score = node.second.AlphaBeta(c, difficulty, -10000, 10000, false, !c.GetTurn());
-        if(move_score > max_move_score) {
-            max_move_score = move_score;
-            ideal_moves.clear();
-            ideal_moves.emplace_back(node.first);
+// Iterative deepening up to the given depth. The root moves persist between iterations and are searched in the order of
+// their last scores, ties broken by the sizes of their subtrees, so the best move so far always comes first. Later moves
+// are searched with a window just below the best score: that is enough to tell whether they tie with it, and a bot
+// picks randomly among all moves sharing the best score. An iteration cut short by the time manager is thrown away.
+// The helper threads of a lazy SMP search start with other moves and every other one a ply deeper, so that they spread
+// over the tree and leave results in the shared table that the others can use.
+std::string PathNode::AlphaBetaRoot(Chess &c, unsigned short &difficulty, SearchThread &thread) noexcept {
+    root_moves.clear();
+    best_moves.clear();
+    best_move_stability = 0;
+    completed_depth = 0;
+    for(auto &move : c.AllMoves()) {
+        Chess::ChangeToRealCoordinates(move[0], move[1], move[2], move[3]);
+        if(c.GetPiece(move[2], move[3]) == W_KING - 7*c.GetTurn())
+            return move;
+        root_moves.push_back({move, 0, 0});
+    }
+    if(root_moves.empty())
+        return "";
+    if(root_moves.size() == 1) {        // forced, nothing to search
+        best_moves.emplace_back(root_moves.front().move);
+        return best_moves.front();
+    }
+    const Bitboard &occupied = c.Occupancy();
+    for(auto &root_move : root_moves)        // the first iteration goes by the guesses of ScoreMove
+        root_move.score = c.ScoreMove(root_move.move, occupied);
+    std::sort(root_moves.begin(), root_moves.end(), [](const RootMove &a, const RootMove &b) { return a.score != b.score ? a.score > b.score : a.move < b.move; });
+    std::rotate(root_moves.begin(), root_moves.begin() + thread.GetIndex() % root_moves.size(), root_moves.end());
+    std::vector<std::string> iteration_moves;
+    for(unsigned short depth=thread.GetIndex()%2;depth<=difficulty;++depth) {
+        const std::string previous_best = root_moves.front().move;
+        float max_move_score = -9999;
+        iteration_moves.clear();
+        for(auto &root_move : root_moves) {
+            const unsigned long long nodes = c.GetNodes();
+            const std::string &move = root_move.move;
+#ifdef COPY_MAKE
+            const BoardState state = c.GetState();
+#endif
+            c.MovePiece(move[0], move[1], move[2], move[3], false, false);
+            thread.Enter(move);
+            unsigned short remaining_depth = depth;
+            root_move.score = PathNode().AlphaBeta(c, remaining_depth, max_move_score - 0.25f, 10000, false, !c.GetTurn(), thread);
+            root_move.nodes = c.GetNodes() - nodes;
+            thread.Leave();
+#ifdef COPY_MAKE
+            c.MovePieceBack(state);
+#else
+            c.MovePieceBack(move[0], move[1], move[2], move[3]);
+#endif
+            if(thread.Stopped())
+                break;
+            if(root_move.score > max_move_score) {
+                max_move_score = root_move.score;
+                iteration_moves.clear();
+                iteration_moves.emplace_back(move);
+            }
+            else if(root_move.score == max_move_score)
+                iteration_moves.emplace_back(move);
         }
-        else if(move_score == max_move_score)
-            ideal_moves.emplace_back(node.first);
-        c.MovePieceBack(node.first[0], node.first[1], node.first[2], node.first[3]);
+        if(thread.Stopped())
+            break;
+        best_moves = iteration_moves;
+        completed_depth = depth;
+        std::stable_sort(root_moves.begin(), root_moves.end(), [](const RootMove &a, const RootMove &b) {
+            return a.score != b.score ? a.score > b.score : a.nodes > b.nodes;
+        });
+        best_move_stability = root_moves.front().move == previous_best ? best_move_stability + 1 : 0;
+        if(!thread.GetTimeManager().NextIteration(root_moves.front().score, root_moves.size() > 1 ? root_moves[1].score : -9999, root_moves.size(), best_move_stability))
+            break;
     }
-    child_node_list.clear();
-    auto move = ideal_moves.cbegin();
-    advance(move, GetRandomNumber<unsigned short>(0, ideal_moves.size()-1));
-    return *move;
+    return best_moves.empty() ? "" : best_moves[GetRandomNumber<unsigned short>(0, best_moves.size()-1)];
 }
 
-// --- Chess Implementation ---
+// --- Bot Implementation ---
+// answers from an earlier search of the same position if it went at least as deep as asked for
+std::string Bot::GetIdealMove(Chess &c, unsigned short difficulty) noexcept {
+    time_manager.Start();
+    const HashKey &key = c.GetSearchKey();
+    std::string move;
+    if(ProbeRootResult(key, difficulty, move))
+        return move;
+    move = Search(c, difficulty);
+    StoreRootResult(key);
+    return move;
+}
 
-// constructor of chess class
-Chess::Chess(const std::string &player1, const unsigned short &difficulty1, const std::string &player2, const unsigned short &difficulty2, bool white_bot_random, bool black_bot_random) noexcept
-: white(player1, difficulty1), black(player2, difficulty2), white_bot_random(white_bot_random), black_bot_random(black_bot_random) {
-    CopyBoard(STARTING_BOARD, board);
+// Answers from an earlier search of the same position if it went at least as deep as the last timed search did, which
+// is about as deep as this clock would allow.
+std::string Bot::GetIdealMove(Chess &c, const GameClock &clock, unsigned short depth) noexcept {
+    time_manager.Start(clock, c.GetTurn());
+    const HashKey &key = c.GetSearchKey();
+    std::string move;
+    if(ProbeRootResult(key, std::min(timed_depth, depth), move))
+        return move;
+    move = Search(c, depth);
+    if(root.GetRootMoves().size() > 1)
+        timed_depth = root.GetCompletedDepth();
+    StoreRootResult(key);
+    return move;
 }
 
-// checks whether the given coordinate is within board boundaries or not
-bool Chess::WithinBounds(const short &coord) noexcept {
-    return coord>=0 && coord<BOARD_SIZE;
+std::string Bot::Search(Chess &c, unsigned short &depth) noexcept {
+    if(parallel_search)
+        return parallel_search->Search(c, root, depth, time_manager);
+    SearchThread thread(nullptr, 0, time_manager);
+    return root.AlphaBetaRoot(c, depth, thread);
 }
 
-// changes the given board coordinates from ASCII to numerical, e.g. ('d', '3') -> (3, 5)
-void Chess::ChangeToRealCoordinates(char &x1, char &y1, char &x2, char &y2) noexcept {
-    x1 -= 'a', x2 -= 'a';
-    y1 = '8'-y1, y2 = '8'-y2;
+// more than one thread makes the bot search with the given parallel algorithm; an unchanged setting keeps the table
+void Bot::SetThreads(const unsigned short &threads, const ParallelMode &mode) noexcept {
+    if(parallel_search && parallel_search->GetThreads() == threads && parallel_search->GetMode() == mode)
+        return;
+    parallel_search = threads > 1 ? std::make_shared<ParallelSearch>(threads, mode, SEARCH_HASH_MB) : nullptr;
 }
 
-// changes the given board coordinates from numerical to ASCII, e.g. (3, 5) -> ('d', '3')
-void Chess::ChangeToString(char &x1, char &y1, char &x2, char &y2) noexcept {
-    x1 += 'a', x2 += 'a';
-    y1 = '8'-y1, y2 = '8'-y2;
+bool Bot::ProbeRootResult(const HashKey &key, const unsigned short &depth, std::string &move) const noexcept {
+    if(root_results.empty())
+        return false;
+    const RootResult &entry = root_results[key & (ROOT_TABLE_SIZE - 1)];
+    if(entry.key != key || entry.depth < depth)
+        return false;
+    move = entry.best_moves[GetRandomNumber<unsigned short>(0, entry.best_moves.size()-1)];
+    return true;
 }
 
-// returns the given numerical board coordinates as a string
-std::string Chess::ToString(const short &x1, const short &y1, const short &x2, const short &y2) noexcept {
-    return {static_cast<char>(x1+'a'), static_cast<char>('8'-y1), static_cast<char>(x2+'a'), static_cast<char>('8'-y2)};
+// keeps the result of the search that just finished; forced moves and king captures are quicker to find again
+void Bot::StoreRootResult(const HashKey &key) noexcept {
+    if(root.GetRootMoves().size() <= 1 || root.GetBestMoves().empty())
+        return;
+    if(root_results.empty())
+        root_results.resize(ROOT_TABLE_SIZE);
+    root_results[key & (ROOT_TABLE_SIZE - 1)] = {key, root.GetCompletedDepth(), root.GetBestMoves()};
 }
 
-// returns the name that is displayed on the terminal for the given piece
-std::string Chess::PieceNameToString(const char &piece) noexcept {
-    switch(piece) {
-        case W_PAWN:    return "W_PAWN";
-        case B_PAWN:    return "B_PAWN";
-        case W_ROOK:    return "W_ROOK";
-        case B_ROOK:    return "B_ROOK";
-        case W_KNIGHT:  return "W_KNIGHT";
-        case B_KNIGHT:  return "B_KNIGHT";
-        case W_BISHOP:  return "W_BISHOP";
-        case B_BISHOP:  return "B_BISHOP";
-        case W_QUEEN:   return "W_QUEEN";
-        case B_QUEEN:   return "B_QUEEN";
-        case W_KING:    return "W_KING";
-        case B_KING:    return "B_KING";
-        default:        return "";
+// --- TimeManager Implementation ---
+void TimeManager::Start() noexcept {
+    start = std::chrono::steady_clock::now();
+    soft_limit = hard_limit = iteration_end = iteration_time = 0;
+    best_scores.clear();
+    stopped = false;
+}
+
+// Plans the move as one of the moves left until the next time control (DEFAULT_MOVES_TO_GO if the clock has none),
+// plus most of the increment, but never more than half of the time left. The hard limit allows overrunning that
+// up to four times, and never more than three quarters of the time left.
+void TimeManager::Start(const GameClock &clock, const bool &white) noexcept {
+    Start();
+    const double &time_left = (white ? clock.white_time : clock.black_time) / 1000.0;
+    const double &increment = (white ? clock.white_increment : clock.black_increment) / 1000.0;
+    const double available = std::max(time_left - MOVE_OVERHEAD, 0.001);
+    soft_limit = std::min(available / (clock.moves_to_go ? clock.moves_to_go : DEFAULT_MOVES_TO_GO) + 0.75 * increment, available / 2);
+    hard_limit = std::min(4 * soft_limit, 0.75 * available);
+}
+
+// Spends at most the given number of seconds, less MOVE_OVERHEAD, on the move. Half of that is the soft limit, so that
+// the search rather ends early than starts an iteration that would probably run into the deadline.
+void TimeManager::Start(const double &move_time) noexcept {
+    Start();
+    hard_limit = std::max(move_time - MOVE_OVERHEAD, 0.001);
+    soft_limit = hard_limit / 2;
+}
+
+double TimeManager::Elapsed() const noexcept {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// polled by every search node; looks at the clock and the stop signal every 1024 nodes, and only once an iteration has
+// been completed, so that there is always a move to play
+bool TimeManager::ShouldStop(const unsigned long long &nodes) noexcept {
+    if(!stopped && !best_scores.empty() && !(nodes & 1023))
+        stopped = (hard_limit > 0 && Elapsed() >= hard_limit) || (stop_signal && stop_signal->load(std::memory_order_relaxed));
+    return stopped;
+}
+
+// Called after every finished iteration; returns whether to start the next one. The soft limit shrinks when the best
+// move has stayed the same for a few iterations or is far ahead of every other move, and grows when the best move has
+// just changed or its score is dropping. Scores are compared with the iteration before the last one, as without a
+// quiescence search they swing with the parity of the depth. An iteration is not started if it would probably run
+// into the hard limit, assuming it grows over the last one as much as the last one did over the one before.
+bool TimeManager::NextIteration(const float &best_score, const float &runner_up_score, const size_t &root_moves, const unsigned short &best_move_stability) noexcept {
+    const double &elapsed = Elapsed(), &last_iteration_time = elapsed - iteration_end;
+    const double &growth = iteration_time > 0 ? std::max(last_iteration_time / iteration_time, 2.0) : 4.0;
+    iteration_end = elapsed, iteration_time = last_iteration_time;
+    best_scores.push_back(best_score);
+    if(stop_signal && stop_signal->load(std::memory_order_relaxed))
+        return false;
+    if(!soft_limit)
+        return true;
+    if(root_moves == 1)
+        return false;
+    double scale = 1;
+    if(!best_move_stability)
+        scale *= 1.5;
+    else if(best_move_stability >= 3)
+        scale *= 0.6;
+    if(best_move_stability && runner_up_score < best_score - 90)
+        scale *= 0.3;
+    if(best_scores.size() > 2) {
+        const float &change = best_score - best_scores[best_scores.size()-3];
+        scale *= change < -30 ? 1.5 : change < -10 ? 1.2 : 1;
     }
+    return elapsed < soft_limit * scale && elapsed + growth * iteration_time < hard_limit;
 }
 
-// returns the worth of the given piece in terms of points
+// --- SearchTable Implementation ---
+SearchTable::SearchTable(const size_t &megabytes) noexcept {
+    size_t size = 1;
+    while(2 * size * sizeof(Entry) <= megabytes * 1024 * 1024)
+        size *= 2;
+    entries = std::vector<Entry>(size);
+}
+
+// the data holds the score's bits, the thread that wrote the entry, the bound and the depth, from the top down
+bool SearchTable::Probe(const HashKey &key, const unsigned short &depth, const float &alpha, const float &beta, float &score, const unsigned short &thread, TableStats &stats) const noexcept {
+    const Entry &entry = entries[key & (entries.size() - 1)];
+    const unsigned long long &data = entry.data.load(std::memory_order_relaxed);
+    ++stats.probes;
+    if((entry.key.load(std::memory_order_relaxed) ^ data) != key || (data & 0xFF) < depth)
+        return false;
+    const unsigned int &bits = data >> 32;
+    std::memcpy(&score, &bits, sizeof(score));
+    const Bound &bound = static_cast<Bound>((data >> 8) & 3);
+    if(bound != EXACT_BOUND && (bound != LOWER_BOUND || score < beta) && (bound != UPPER_BOUND || score > alpha))
+        return false;
+    ++stats.hits;
+    stats.shared_hits += ((data >> 16) & 0xFF) != (thread & 0xFF);
+    return true;
+}
+
+void SearchTable::Store(const HashKey &key, const unsigned short &depth, const float &score, const Bound &bound, const unsigned short &thread, TableStats &stats) noexcept {
+    Entry &entry = entries[key & (entries.size() - 1)];
+    const unsigned long long &old_data = entry.data.load(std::memory_order_relaxed);
+    ++stats.stores;
+    stats.replacements += old_data && (entry.key.load(std::memory_order_relaxed) ^ old_data) != key && ((old_data >> 16) & 0xFF) != (thread & 0xFF);
+    unsigned int bits;
+    std::memcpy(&bits, &score, sizeof(bits));
+    const unsigned long long &data = static_cast<unsigned long long>(bits) << 32 | (thread & 0xFF) << 16 | bound << 8 | depth;
+    entry.key.store(key ^ data, std::memory_order_relaxed);
+    entry.data.store(data, std::memory_order_relaxed);
+}
+
+// --- SearchThread Implementation ---
+bool SearchThread::ProbeTable(const HashKey &key, const unsigned short &depth, const float &alpha, const float &beta, float &score) noexcept {
+    return search && search->GetTable().Probe(key, depth, alpha, beta, score, index, stats);
+}
+
+void SearchThread::StoreTable(const HashKey &key, const unsigned short &depth, const float &score, const Bound &bound) noexcept {
+    search->GetTable().Store(key, depth, score, bound, index, stats);
+}
+
+// polled by every search node: the clock, a stop of the whole search, or a cutoff at a split point above the node
+bool SearchThread::ShouldStop(const unsigned long long &nodes) noexcept {
+    if(time_manager.ShouldStop(nodes) && search)
+        search->Stop();
+    return Stopped();
+}
+
+bool SearchThread::Stopped() const noexcept {
+    if(time_manager.Stopped())
+        return true;
+    if(!search)
+        return false;
+    if(search->Stopped())
+        return true;
+    for(const SplitPoint *sp=split_point;sp;sp=sp->parent)
+        if(sp->cutoff.load(std::memory_order_relaxed))
+            return true;
+    return false;
+}
+
+// takes back the moves that lead away from the target node and plays the ones that lead to it
+void SearchThread::GoTo(Chess &c, const std::vector<std::string> &target) noexcept {
+    size_t common = 0;
+    while(common < path.size() && common < target.size() && path[common] == target[common])
+        ++common;
+    while(path.size() > common) {
+        const std::string &move = path.back();
+        c.MovePieceBack(move[0], move[1], move[2], move[3]);
+        path.pop_back();
+    }
+    for(;common<target.size();++common) {
+        const std::string &move = target[common];
+        c.MovePiece(move[0], move[1], move[2], move[3], false, false);
+        path.push_back(move);
+    }
+}
+
+bool SearchThread::CanSplit(const unsigned short &depth) const noexcept {
+    return search && search->WantsSplit(depth);
+}
+
+float SearchThread::Split(Chess &c, const std::vector<std::string> &moves, const unsigned short &depth, const float &alpha, const float &beta, const bool &maximizing_player, const bool &initial_turn, const float &points) noexcept {
+    return search->Split(c, *this, moves, depth, alpha, beta, maximizing_player, initial_turn, points);
+}
+
+// --- ParallelSearch Implementation ---
+ParallelSearch::ParallelSearch(const unsigned short &threads, const ParallelMode &mode, const size_t &hash_megabytes) noexcept
+: mode(mode), threads(std::max<unsigned short>(threads, 1)), table(hash_megabytes), queues(this->threads) {}
+
+// splitting only pays off with a thread idle to take the work and enough depth left to be worth handing over
+bool ParallelSearch::WantsSplit(const unsigned short &depth) const noexcept {
+    return mode == YOUNG_BROTHERS_WAIT && depth >= MIN_SPLIT_DEPTH && idle_threads.load(std::memory_order_relaxed);
+}
+
+// the newest task of the thread's own queue, or else the oldest task of another thread
+bool ParallelSearch::NextTask(const unsigned short &index, SplitTask &task) noexcept {
+    for(unsigned short i=0;i<threads;++i) {
+        WorkQueue &queue = queues[(index + i) % threads];
+        if(!queue.size.load(std::memory_order_relaxed))
+            continue;
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if(queue.tasks.empty())
+            continue;
+        if(!i)
+            task = queue.tasks.back(), queue.tasks.pop_back();
+        else
+            task = queue.tasks.front(), queue.tasks.pop_front();
+        queue.size.store(queue.tasks.size(), std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+// Searches the moves left at a node after its first one with all threads that want work, the calling thread included.
+// While waiting for the others to finish, the owner takes on any other work so as not to sit idle.
+float ParallelSearch::Split(Chess &c, SearchThread &thread, const std::vector<std::string> &moves, const unsigned short &depth, const float &alpha, const float &beta, const bool &maximizing_player, const bool &initial_turn, const float &points) noexcept {
+    SplitPoint split_point;
+    split_point.parent = thread.split_point;
+    split_point.path = thread.path;
+    split_point.depth = depth;
+    split_point.alpha = alpha, split_point.beta = beta, split_point.points = points;
+    split_point.maximizing_player = maximizing_player, split_point.initial_turn = initial_turn;
+    split_point.cutoff = false;
+    split_point.pending = moves.size();
+    WorkQueue &queue = queues[thread.index];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        for(auto move = moves.crbegin(); move != moves.crend(); ++move)
+            queue.tasks.push_back({&split_point, *move});
+        queue.size.store(queue.tasks.size(), std::memory_order_relaxed);
+    }
+    while(split_point.pending.load(std::memory_order_acquire)) {
+        SplitTask task;
+        if(NextTask(thread.index, task))
+            Execute(c, thread, task);
+        else
+            std::this_thread::yield();
+    }
+    thread.GoTo(c, split_point.path);
+    return split_point.points;
+}
+
+// searches one move of a split point with the window as it stands, and merges the score unless the search was cut short
+void ParallelSearch::Execute(Chess &c, SearchThread &thread, const SplitTask &task) noexcept {
+    SplitPoint &split_point = *task.split_point;
+    SplitPoint *outer = thread.split_point;
+    thread.split_point = &split_point;
+    if(!thread.Stopped()) {
+        thread.GoTo(c, split_point.path);
+        float alpha, beta, score;
+        {
+            std::lock_guard<std::mutex> lock(split_point.mutex);
+            alpha = split_point.alpha, beta = split_point.beta;
+        }
+        const std::string &move = task.move;
+        if(c.GetPiece(move[2], move[3]) == W_KING - 7*c.GetTurn())
+            score = split_point.maximizing_player ? 9999 : -9999;
+        else {
+            unsigned short depth = split_point.depth - 1;
+            c.MovePiece(move[0], move[1], move[2], move[3], false, false);
+            thread.Enter(move);
+            score = PathNode().AlphaBeta(c, depth, alpha, beta, !split_point.maximizing_player, split_point.initial_turn, thread);
+            thread.Leave();
+            c.MovePieceBack(move[0], move[1], move[2], move[3]);
+        }
+        if(!thread.Stopped()) {
+            std::lock_guard<std::mutex> lock(split_point.mutex);
+            if(split_point.maximizing_player)
+                split_point.points = std::max(split_point.points, score), split_point.alpha = std::max(split_point.alpha, score);
+            else
+                split_point.points = std::min(split_point.points, score), split_point.beta = std::min(split_point.beta, score);
+            if(split_point.alpha >= split_point.beta)
+                split_point.cutoff = true;
+        }
+    }
+    thread.split_point = outer;
+    split_point.pending.fetch_sub(1, std::memory_order_release);
+}
+
+// the work loop of the helper threads of a young brothers wait search
+void ParallelSearch::Help(Chess &c, SearchThread &thread) noexcept {
+    bool idle = false;
+    while(!Stopped()) {
+        SplitTask task;
+        if(NextTask(thread.index, task)) {
+            if(idle)
+                --idle_threads, idle = false;
+            Execute(c, thread, task);
+        }
+        else {
+            if(!idle)
+                ++idle_threads, idle = true;
+            std::this_thread::yield();
+        }
+    }
+}
+
+// Every helper thread gets a copy of the game. The first thread searches on the given one and its result is played;
+// the helpers are stopped as soon as it is done.
+std::string ParallelSearch::Search(Chess &c, PathNode &root, unsigned short &difficulty, TimeManager &time_manager) noexcept {
+    stop = false;
+    idle_threads = 0;
+    const unsigned long long start_nodes = c.GetNodes();
+    std::vector<Chess> boards(threads - 1, c);
+    std::vector<TableStats> thread_stats(threads);
+    std::vector<std::thread> helpers;
+    for(unsigned short i=1;i<threads;++i)
+        helpers.emplace_back([this, &boards, &thread_stats, i, difficulty]() {
+            TimeManager unlimited;
+            unlimited.Start();
+            SearchThread thread(this, i, unlimited);
+            if(mode == LAZY_SMP) {
+                unsigned short depth = difficulty;
+                PathNode().AlphaBetaRoot(boards[i-1], depth, thread);
+            }
+            else
+                Help(boards[i-1], thread);
+            thread_stats[i] = thread.stats;
+        });
+    SearchThread thread(this, 0, time_manager);
+    const std::string &move = root.AlphaBetaRoot(c, difficulty, thread);
+    Stop();
+    for(auto &helper : helpers)
+        helper.join();
+    thread_stats[0] = thread.stats;
+    nodes = c.GetNodes() - start_nodes;
+    for(const auto &board : boards)
+        nodes += board.GetNodes() - start_nodes;
+    table_stats = {};
+    for(const auto &stats : thread_stats) {
+        table_stats.probes += stats.probes, table_stats.hits += stats.hits, table_stats.shared_hits += stats.shared_hits;
+        table_stats.stores += stats.stores, table_stats.replacements += stats.replacements;
+    }
+    return move;
+}
+
+// --- PerftTable Implementation ---
+PerftTable::PerftTable(const size_t &megabytes) noexcept {
+    size_t size = 1;
+    while(2 * size * sizeof(Entry) <= megabytes * 1024 * 1024)
+        size *= 2;
+    entries = std::vector<Entry>(size);
+}
+
+size_t PerftTable::Index(const HashKey &key, const unsigned short &depth, const size_t &size) noexcept {
+    return (key ^ (depth * 0x9E3779B97F4A7C15ULL)) & (size - 1);
+}
+
+bool PerftTable::Probe(const HashKey &key, const unsigned short &depth, unsigned long long &leaf_nodes) const noexcept {
+    const Entry &entry = entries[Index(key, depth, entries.size())];
+    const unsigned long long &data = entry.data.load(std::memory_order_relaxed);
+    if((entry.key.load(std::memory_order_relaxed) ^ data) != key || (data & 0xFF) != depth)
+        return false;
+    leaf_nodes = data >> 8;
+    return true;
+}
+
+void PerftTable::Store(const HashKey &key, const unsigned short &depth, const unsigned long long &leaf_nodes) noexcept {
+    Entry &entry = entries[Index(key, depth, entries.size())];
+    const unsigned long long &data = (leaf_nodes << 8) | depth;
+    entry.key.store(key ^ data, std::memory_order_relaxed);
+    entry.data.store(data, std::memory_order_relaxed);
+}
+
+// --- Chess Implementation ---
+
+// constructor of chess class
+Chess::Chess(const std::string &player1, const unsigned short &difficulty1, const std::string &player2, const unsigned short &difficulty2, bool white_bot_random, bool black_bot_random) noexcept
+: white(player1, difficulty1), black(player2, difficulty2), white_bot_random(white_bot_random), black_bot_random(black_bot_random) {
+    SetUpBoard(STARTING_BOARD);
+}
+
+// checks whether the given coordinate is within board boundaries or not
+bool Chess::WithinBounds(const short &coord) noexcept {
+    return coord>=0 && coord<BOARD_SIZE;
+}
+
+// changes the given board coordinates from ASCII to numerical, e.g. ('d', '3') -> (3, 5)
+void Chess::ChangeToRealCoordinates(char &x1, char &y1, char &x2, char &y2) noexcept {
+    x1 -= 'a', x2 -= 'a';
+    y1 = '8'-y1, y2 = '8'-y2;
+}
+
+// changes the given board coordinates from numerical to ASCII, e.g. (3, 5) -> ('d', '3')
+void Chess::ChangeToString(char &x1, char &y1, char &x2, char &y2) noexcept {
+    x1 += 'a', x2 += 'a';
+    y1 = '8'-y1, y2 = '8'-y2;
+}
+
+// returns a move in numerical board coordinates, as used by the search, in coordinate notation, e.g. "e2e4"
+std::string Chess::ToCoordinateString(const std::string &move) noexcept {
+    return ToString(move[0], move[1], move[2], move[3]);
+}
+
+// returns the given numerical board coordinates as a string
+std::string Chess::ToString(const short &x1, const short &y1, const short &x2, const short &y2) noexcept {
+    return {static_cast<char>(x1+'a'), static_cast<char>('8'-y1), static_cast<char>(x2+'a'), static_cast<char>('8'-y2)};
+}
+
+// returns the name that is displayed on the terminal for the given piece
+std::string Chess::PieceNameToString(const char &piece) noexcept {
+    switch(piece) {
+        case W_PAWN:    return "W_PAWN";
+        case B_PAWN:    return "B_PAWN";
+        case W_ROOK:    return "W_ROOK";
+        case B_ROOK:    return "B_ROOK";
+        case W_KNIGHT:  return "W_KNIGHT";
+        case B_KNIGHT:  return "B_KNIGHT";
+        case W_BISHOP:  return "W_BISHOP";
+        case B_BISHOP:  return "B_BISHOP";
+        case W_QUEEN:   return "W_QUEEN";
+        case B_QUEEN:   return "B_QUEEN";
+        case W_KING:    return "W_KING";
+        case B_KING:    return "B_KING";
+        default:        return "";
+    }
+}
+
+// returns the worth of the given piece in terms of points
 float Chess::EvaluatePiece(const char &piece) noexcept {
     switch(piece) {
         case W_PAWN:
@@ -339,12 +1627,8 @@ void Chess::PrintSeparator(const char &ch) noexcept {
     std::cout << std::string(BOX_WIDTH, ch) << std::endl << TO_RIGHT;
 }
 
-void Chess::CopyBoard(const char from[BOARD_SIZE][BOARD_SIZE], char to[BOARD_SIZE][BOARD_SIZE]) noexcept {
-    std::copy(*from, *from + BOARD_SIZE*BOARD_SIZE, *to);
-}
-
-bool Chess::AreBoardsEqual(const char board1[BOARD_SIZE][BOARD_SIZE], const char board2[BOARD_SIZE][BOARD_SIZE]) noexcept {
-    return std::equal(*board1, *board1 + BOARD_SIZE*BOARD_SIZE, *board2);
+void Chess::CopyBoard(const char from[MAILBOX_SIZE], char to[MAILBOX_SIZE]) noexcept {
+    std::copy(from, from + MAILBOX_SIZE, to);
 }
 
 bool Chess::CanMovePiece(const short &x1, const short &y1, const short &x2, const short &y2, const std::forward_list<std::string> &all_moves) noexcept {
@@ -352,7 +1636,7 @@ bool Chess::CanMovePiece(const short &x1, const short &y1, const short &x2, cons
 }
 
 char Chess::GetPiece(const short &x, const short &y) const noexcept {
-    return board[y][x];
+    return board[Mailbox(x, y)];
 }
 
 bool Chess::GetTurn() const noexcept {
@@ -363,7 +1647,7 @@ Bot& Chess::GetCurrentPlayer() noexcept {
     return whites_turn ? white : black;
 }
 
-Bot Chess::GetCurrentPlayerConst() const noexcept {
+const Bot& Chess::GetCurrentPlayerConst() const noexcept {
     return whites_turn ? white : black;
 }
 
@@ -371,7 +1655,7 @@ Bot& Chess::GetOtherPlayer() noexcept {
     return whites_turn ? black : white;
 }
 
-Bot Chess::GetOtherPlayerConst() const noexcept {
+const Bot& Chess::GetOtherPlayerConst() const noexcept {
     return whites_turn ? black : white;
 }
 
@@ -380,17 +1664,18 @@ void Chess::ChangeTurn() noexcept {
 }
 
 void Chess::AppendToAllGameMoves(const short &x1, const short &y1, const short &x2, const short &y2) noexcept {
-    if(GetCurrentPlayerConst().GetCastling() && (board[y1][x1] == B_KING + 7*whites_turn) && (x2 == 2 || x2 == 6))
+    if(GetCurrentPlayerConst().GetCastling() && (board[Mailbox(x1, y1)] == B_KING + 7*whites_turn) && (x2 == 2 || x2 == 6))
         all_game_moves.emplace_back(CASTLING, std::string(1, x2));
     else
-        all_game_moves.emplace_back(NORMAL, ToString(x1, y1, x2, y2) + board[y1][x1] + board[y2][x2]);
+        all_game_moves.emplace_back(NORMAL, ToString(x1, y1, x2, y2) + board[Mailbox(x1, y1)] + board[Mailbox(x2, y2)]);
 }
 
 void Chess::Reset() noexcept {
-    CopyBoard(STARTING_BOARD, board);
+    SetUpBoard(STARTING_BOARD);
     white.Reset();
     black.Reset();
     all_game_moves.clear();
+    position_keys.clear();
     whites_turn = true;
     moves_after_last_pawn_move_or_capture = 0;
 #ifdef _WIN32
@@ -423,6 +1708,12 @@ bool Chess::EndGameText(const unsigned short &n, const Endgame &end_game) const
         default:
             std::cout << "!!!Draw!!!" << CLEAR_LINE << std::endl << TO_RIGHT;
             switch(end_game) {
+                case STALEMATE:
+                    std::cout << "Stalemate: " << GetCurrentPlayerConst().GetName() << " has no legal move but is not in check.";
+                    return true;
+                case INSUFFICIENT_MATERIAL:
+                    std::cout << "Insufficient material: Neither player can checkmate with the pieces left.";
+                    return true;
                 case FIFTY_MOVES:
                     std::cout << "Fifty-move rule: No capture has been made and no pawn has been moved in the last 50 moves.";
                     return true;
@@ -435,330 +1726,481 @@ bool Chess::EndGameText(const unsigned short &n, const Endgame &end_game) const
     }
 }
 
-short Chess::GetEnPassant(const short &x, const short &y) const noexcept {
-    if(all_game_moves.empty())
+template<Color Us> short Chess::GetEnPassant(const short &x, const short &y) const noexcept {
+    constexpr short row = Us == WHITE ? 3 : 4;
+    if(y != row || all_game_moves.empty())
         return -1;
     if(all_game_moves.back().first != NORMAL)
         return -1;
     auto last_move = all_game_moves.back().second;
     ChangeToRealCoordinates(last_move[0], last_move[1], last_move[2], last_move[3]);
-    return ((last_move[4] == W_PAWN - 7*whites_turn) && (abs(last_move[0] - x) == 1) && (last_move[3]-last_move[1] == 2*(whites_turn ? 1 : -1)) && (y == 4 - whites_turn)) ? last_move[0] : -1;
+    return ((last_move[4] == MakePiece<Opposite(Us)>(W_PAWN)) && (abs(last_move[0] - x) == 1) && (last_move[3]-last_move[1] == (Us == WHITE ? 2 : -2))) ? last_move[0] : -1;
 }
 
-template<class Iterator> short Chess::GetEnPassant(const char board[BOARD_SIZE][BOARD_SIZE], const Iterator &it) const noexcept {
-    if(it->first != NORMAL)
-        return -1;
-    auto last_move = it->second;
-    ChangeToRealCoordinates(last_move[0], last_move[1], last_move[2], last_move[3]);
-    for(short x=0;x<BOARD_SIZE;++x)
-        if(board[3 + whites_turn][x] == W_PAWN - 7*whites_turn)
-            if((last_move[4] == B_PAWN + 7*whites_turn) && (abs(last_move[0] - x) == 1) && (last_move[3] - last_move[1] == 2*(whites_turn ? -1 : 1)))
-                return last_move[0];
-    return -1;
-}
-
-bool Chess::ThreefoldRepetition() const noexcept {
-    static char prev_board[BOARD_SIZE][BOARD_SIZE];
-    CopyBoard(board, prev_board);
-    unsigned short position_count = 1;
-    auto it = all_game_moves.crbegin();
-    auto last_move = it->second;
-    while(true) {
-        for(unsigned short i=0;i<2;++i)    {
-            switch(it->first) {
-                case CASTLING:
-                    return false;
-                default:
-                    if(last_move[4] == W_PAWN || last_move[4] == B_PAWN || last_move[5] != EMPTY)
-                        return false;
-                    ChangeToRealCoordinates(last_move[0], last_move[1], last_move[2], last_move[3]);
-                    prev_board[short(last_move[1])][short(last_move[0])] = last_move[4], prev_board[short(last_move[3])][short(last_move[2])] = EMPTY;
-                    if(it->first == EN_PASSANT)
-                        prev_board[short(last_move[1])][short(last_move[2])] = i == whites_turn ? B_PAWN : W_PAWN;
+char Chess::PieceOn(const short &sq) const noexcept {
+    return board[Mailbox(sq % BOARD_SIZE, sq / BOARD_SIZE)];
+}
+
+// every board change during a game goes through here, so that the piece part of the Zobrist key, the evaluation and the piece lists stay up to date
+void Chess::SetPiece(const short &x, const short &y, const char &piece) noexcept {
+    const short &sq = y*BOARD_SIZE + x, &square = Mailbox(x, y);
+    piece_key ^= ZOBRIST.pieces[board[square] - B_KING][sq] ^ ZOBRIST.pieces[piece - B_KING][sq];
+    evaluation += EVALUATION_TABLE[piece - B_KING][sq] - EVALUATION_TABLE[board[square] - B_KING][sq];
+#ifdef ATTACK_TABLES
+    if(board[square] != EMPTY)
+        UpdateAttacks(square, board[square], -1);
+    if((board[square] == EMPTY) != (piece == EMPTY))
+        UpdateRaysThrough(square, piece == EMPTY ? 1 : -1);
+#endif
+    if(board[square] != EMPTY) {        // the last square of the group takes the place of the removed one
+        const short &group = board[square] - B_KING;
+        const unsigned char &last = piece_lists.squares[group][--piece_lists.count[group]];
+        piece_lists.squares[group][piece_lists.index[sq]] = last;
+        piece_lists.index[last] = piece_lists.index[sq];
+    }
+    if(piece != EMPTY) {
+        piece_lists.index[sq] = piece_lists.count[piece - B_KING];
+        piece_lists.squares[piece - B_KING][piece_lists.count[piece - B_KING]++] = sq;
+    }
+    board[square] = piece;
+#ifdef ATTACK_TABLES
+    if(piece != EMPTY)
+        UpdateAttacks(square, piece, 1);
+#endif
+}
+
+// places the pieces of the given board on an empty one, building the piece key, the evaluation and the piece lists on the way
+void Chess::SetUpBoard(const char new_board[BOARD_SIZE][BOARD_SIZE]) noexcept {
+    std::fill(board, board + MAILBOX_SIZE, OFF_BOARD);
+    for(short y=0;y<BOARD_SIZE;++y)
+        for(short x=0;x<BOARD_SIZE;++x)
+            board[Mailbox(x, y)] = EMPTY;
+    piece_key = 0;
+    evaluation = 0;
+    piece_lists = {};
+#ifdef ATTACK_TABLES
+    attacks = {};
+#endif
+    for(short y=0;y<BOARD_SIZE;++y)
+        for(short x=0;x<BOARD_SIZE;++x)
+            SetPiece(x, y, new_board[y][x]);
+}
+
+#ifdef ATTACK_TABLES
+// adds (sign 1) or removes (sign -1) the attacks of the piece on the given mailbox square
+void Chess::UpdateAttacks(const short &square, const char &piece, const short &sign) noexcept {
+    const Color &c = piece > EMPTY ? WHITE : BLACK;
+    const short &white_piece = piece > EMPTY ? piece : piece + 7;
+    const short &kind = ATTACKER_KIND[white_piece], &sq = MailboxToSquare(square);
+    Bitboard targets = 0;
+    switch(white_piece) {
+        case W_PAWN:    targets = PAWN_ATTACKS[c][sq];      break;
+        case W_KNIGHT:  targets = KNIGHT_ATTACKS[sq];       break;
+        case W_KING:    targets = KING_ATTACKS[sq];         break;
+        default:
+            for(short d=0;d<8;++d) {
+                if(white_piece != W_QUEEN && white_piece != (d < 4 ? W_ROOK : W_BISHOP))
+                    continue;
+                const short &step = d < 4 ? ROOK_DIRECTIONS[d] : BISHOP_DIRECTIONS[d-4];
+                for(short to = square + step; board[to] != OFF_BOARD; to += step) {
+                    targets |= 1ULL << MailboxToSquare(to);
+                    if(board[to] != EMPTY)
+                        break;
+                }
             }
-            if((++it) == all_game_moves.crend())
-                return false;
-            last_move = it->second;
-        }
-        if(AreBoardsEqual(prev_board, board))
-            if(GetOtherPlayerConst().GetCastling() == (it->first == CASTLING ? false : last_move[6 + (it->first == PROMOTION)]))
-                if((all_game_moves.size() > 1 ? GetEnPassant(board, prev(all_game_moves.cend(), 2)) : -1)
-                == (next(it) == all_game_moves.crend() ? -1 : GetEnPassant(prev_board, next(it))))
-                    if((++position_count) == 3)
-                        return true;
+    }
+    while(targets) {
+        const short &target = PopLsb(targets);
+        attacks.count[c][target] += sign;
+        attacks.by_kind[c][kind][target] += sign;
     }
 }
 
-bool Chess::IsCheck(const bool &turn) const noexcept {
-    short x = -1, y = -1;
-    for(short i=0;x==-1;++i)
-        for(short j=0;j<BOARD_SIZE;++j)
-            if(board[j][i] == B_KING + 7*turn) {
-                x = i, y = j;
+// a piece appearing on (sign -1) or leaving (sign 1) the given mailbox square cuts or extends the rays of the sliders
+// that reach it; only the part of each ray beyond the square changes
+void Chess::UpdateRaysThrough(const short &square, const short &sign) noexcept {
+    for(short d=0;d<8;++d) {
+        const short &step = d < 4 ? ROOK_DIRECTIONS[d] : BISHOP_DIRECTIONS[d-4];
+        short from = square + step;
+        while(board[from] == EMPTY)
+            from += step;
+        const char &slider = board[from];
+        const short &white_slider = slider > EMPTY ? slider : slider + 7;
+        if(slider == OFF_BOARD || (white_slider != W_QUEEN && white_slider != (d < 4 ? W_ROOK : W_BISHOP)))
+            continue;
+        const Color &c = slider > EMPTY ? WHITE : BLACK;
+        const short &kind = ATTACKER_KIND[white_slider];
+        for(short to = square - step; board[to] != OFF_BOARD; to -= step) {
+            attacks.count[c][MailboxToSquare(to)] += sign;
+            attacks.by_kind[c][kind][MailboxToSquare(to)] += sign;
+            if(board[to] != EMPTY)
                 break;
-            }
-    for(short i=x+1;i<BOARD_SIZE;++i)
-        if(board[y][i] == W_ROOK - 7*turn)            return true;
-        else if(board[y][i] == W_QUEEN - 7*turn)    return true;
-        else if(board[y][i] != EMPTY)    break;
-    for(short i=x-1;i>=0;--i)
-        if(board[y][i] == W_ROOK - 7*turn)            return true;
-        else if(board[y][i] == W_QUEEN - 7*turn)    return true;
-        else if(board[y][i] != EMPTY)    break;
-    for(short i=y+1;i<BOARD_SIZE;++i)
-        if(board[i][x] == W_ROOK - 7*turn)            return true;
-        else if(board[i][x] == W_QUEEN - 7*turn)    return true;
-        else if(board[i][x] != EMPTY)    break;
-    for(short i=y-1;i>=0;--i)
-        if(board[i][x] == W_ROOK - 7*turn)            return true;
-        else if(board[i][x] == W_QUEEN - 7*turn)    return true;
-        else if(board[i][x] != EMPTY)    break;
-    for(short i=x-1, j=y-1; i>=0 && j>=0; --i, --j)
-        if(board[j][i] == W_BISHOP - 7*turn)        return true;
-        else if(board[j][i] == W_QUEEN - 7*turn)    return true;
-        else if(board[j][i] != EMPTY)    break;
-    for(short i=x-1, j=y+1; i>=0 && j<BOARD_SIZE; --i, ++j)
-        if(board[j][i] == W_BISHOP - 7*turn)        return true;
-        else if(board[j][i] == W_QUEEN - 7*turn)    return true;
-        else if(board[j][i] != EMPTY)    break;
-    for(short i=x+1, j=y-1; i<BOARD_SIZE && j>=0; ++i, --j)
-        if(board[j][i] == W_BISHOP - 7*turn)        return true;
-        else if(board[j][i] == W_QUEEN - 7*turn)    return true;
-        else if(board[j][i] != EMPTY)    break;
-    for(short i=x+1, j=y+1; i<BOARD_SIZE && j<BOARD_SIZE; ++i, ++j)
-        if(board[j][i] == W_BISHOP - 7*turn)        return true;
-        else if(board[j][i] == W_QUEEN - 7*turn)    return true;
-        else if(board[j][i] != EMPTY)    break;
-    for(short i=x-1;i<x+2;++i)
-        for(short j=y-1;j<y+2;++j)
-            if((board[j][i] == W_KING - 7*turn) && WithinBounds(i) && WithinBounds(j))            return true;
-    if((board[y-1][x-2] == W_KNIGHT - 7*turn) && (y > 0) && (x > 1))                            return true;
-    else if((board[y-1][x+2] == W_KNIGHT - 7*turn) && (y > 0) && (x < BOARD_SIZE-2))            return true;
-    else if((board[y+1][x-2] == W_KNIGHT - 7*turn) && (y < BOARD_SIZE-1) && (x > 1))            return true;
-    else if((board[y+1][x+2] == W_KNIGHT - 7*turn) && (y < BOARD_SIZE-1) && (x < BOARD_SIZE-2))    return true;
-    else if((board[y-2][x-1] == W_KNIGHT - 7*turn) && (y > 1) && (x > 0))                        return true;
-    else if((board[y-2][x+1] == W_KNIGHT - 7*turn) && (y > 1) && (x < BOARD_SIZE-1))            return true;
-    else if((board[y+2][x-1] == W_KNIGHT - 7*turn) && (y < BOARD_SIZE-2) && (x > 0))            return true;
-    else if((board[y+2][x+1] == W_KNIGHT - 7*turn) && (y < BOARD_SIZE-2) && (x < BOARD_SIZE-1))    return true;
-    else if((board[y + (turn ? -1 : 1)][x+1] == W_PAWN - 7*turn) && (x < BOARD_SIZE-1))            return true;
-    else if((board[y + (turn ? -1 : 1)][x-1] == W_PAWN - 7*turn) && (x > 0))                    return true;
+        }
+    }
+}
+
+template<Color By> unsigned char Chess::AttackCount(const short &sq) const noexcept {
+    return attacks.count[By][sq];
+}
+
+template<Color By> char Chess::LeastValuableAttacker(const short &sq) const noexcept {
+    for(short kind=0;kind<6;++kind)
+        if(attacks.by_kind[By][kind][sq])
+            return MakePiece<By>(KIND_PIECE[kind]);
+    return EMPTY;
+}
+#endif
+
+Bitboard Chess::Occupancy() const noexcept {
+    Bitboard occupied = 0;
+    for(short group=0;group<13;++group)
+        for(unsigned char i=0;i<piece_lists.count[group];++i)
+            occupied |= 1ULL << piece_lists.squares[group][i];
+    return occupied;
+}
+
+// On-the-fly counterpart of the attack tables: counts the pieces of color By attacking the square and finds the least
+// valuable of them (EMPTY if there is none). Slider attacks come from the nearest occupied square on each ray.
+template<Color By> unsigned char Chess::ScanAttackers(const short &sq, const Bitboard &occupied, char &least_valuable) const noexcept {
+    unsigned char count = 0;
+    short cheapest = 6;
+    const auto &found = [&count, &cheapest](const short &kind) {
+        ++count;
+        cheapest = std::min(cheapest, kind);
+    };
+    for(Bitboard squares = PAWN_ATTACKS[Opposite(By)][sq]; squares;)
+        if(PieceOn(PopLsb(squares)) == MakePiece<By>(W_PAWN))      found(ATTACKER_KIND[W_PAWN]);
+    for(Bitboard squares = KNIGHT_ATTACKS[sq]; squares;)
+        if(PieceOn(PopLsb(squares)) == MakePiece<By>(W_KNIGHT))    found(ATTACKER_KIND[W_KNIGHT]);
+    for(Bitboard squares = KING_ATTACKS[sq]; squares;)
+        if(PieceOn(PopLsb(squares)) == MakePiece<By>(W_KING))      found(ATTACKER_KIND[W_KING]);
+    for(short d=0;d<8;++d) {        // even directions run towards higher squares, so their nearest blocker is the lowest one
+        const Bitboard &blockers = RAYS[d][sq] & occupied;
+        if(!blockers)
+            continue;
+        const char &piece = PieceOn(d % 2 ? 63 - __builtin_clzll(blockers) : __builtin_ctzll(blockers));
+        if(piece == MakePiece<By>(W_QUEEN))
+            found(ATTACKER_KIND[W_QUEEN]);
+        else if(piece == MakePiece<By>(d < 4 ? W_ROOK : W_BISHOP))
+            found(ATTACKER_KIND[d < 4 ? W_ROOK : W_BISHOP]);
+    }
+    least_valuable = cheapest < 6 ? MakePiece<By>(KIND_PIECE[cheapest]) : static_cast<char>(EMPTY);
+    return count;
+}
+
+template<Color C> unsigned char Chess::PieceCount(const char &white_piece) const noexcept {
+    return piece_lists.count[(C == WHITE ? white_piece : white_piece - 7) - B_KING];
+}
+
+// returns the file of a pawn that has just made a double step next to a pawn that could capture it en passant, or -1
+short Chess::GetEnPassantFile() const noexcept {
+    if(all_game_moves.empty() || all_game_moves.back().first != NORMAL)
+        return -1;
+    const std::string &last_move = all_game_moves.back().second;
+    const short &x = last_move[2]-'a', &y = '8'-last_move[3];
+    if(last_move[4] != (whites_turn ? B_PAWN : W_PAWN) || abs(last_move[3] - last_move[1]) != 2)
+        return -1;
+    const char &pawn = whites_turn ? W_PAWN : B_PAWN;
+    return (board[Mailbox(x-1, y)] == pawn || board[Mailbox(x+1, y)] == pawn) ? x : -1;
+}
+
+// Zobrist key of the position: pieces, side to move, castling rights and a possible en passant capture
+HashKey Chess::GetKey() const noexcept {
+    const short &en_passant = GetEnPassantFile();
+    return piece_key ^ (whites_turn ? ZOBRIST.side : 0) ^ (white.GetCastling() ? ZOBRIST.castling[WHITE] : 0)
+        ^ (black.GetCastling() ? ZOBRIST.castling[BLACK] : 0) ^ (en_passant != -1 ? ZOBRIST.en_passant[en_passant] : 0);
+}
+
+template<Color Us> short Chess::KingSquare() const noexcept {
+    return PieceCount<Us>(W_KING) ? piece_lists.squares[MakePiece<Us>(W_KING) - B_KING][0] : -1;
+}
+
+template<Color Us> bool Chess::IsCheck() const noexcept {
+#ifdef ATTACK_TABLES
+    return AttackCount<Opposite(Us)>(KingSquare<Us>());
+#else
+    constexpr Color Them = Opposite(Us);
+    constexpr char their_king = MakePiece<Them>(W_KING), queen = MakePiece<Them>(W_QUEEN), rook = MakePiece<Them>(W_ROOK);
+    constexpr char bishop = MakePiece<Them>(W_BISHOP), knight = MakePiece<Them>(W_KNIGHT), pawn = MakePiece<Them>(W_PAWN);
+    const short &sq = KingSquare<Us>(), &x = sq % BOARD_SIZE, &y = sq / BOARD_SIZE;
+    const short &king = Mailbox(x, y);
+    if(PieceCount<Them>(W_ROOK) || PieceCount<Them>(W_QUEEN))
+        for(const short &step : ROOK_DIRECTIONS) {
+            short i = king + step;
+            while(board[i] == EMPTY)
+                i += step;
+            if(board[i] == rook || board[i] == queen)    return true;
+        }
+    if(PieceCount<Them>(W_BISHOP) || PieceCount<Them>(W_QUEEN))
+        for(const short &step : BISHOP_DIRECTIONS) {
+            short i = king + step;
+            while(board[i] == EMPTY)
+                i += step;
+            if(board[i] == bishop || board[i] == queen)    return true;
+        }
+    for(Bitboard squares = KNIGHT_ATTACKS[sq]; squares;)
+        if(PieceOn(PopLsb(squares)) == knight)        return true;
+    for(Bitboard squares = KING_ATTACKS[sq]; squares;)
+        if(PieceOn(PopLsb(squares)) == their_king)    return true;
+    // an opponent pawn attacks the king from the squares a pawn of ours would attack from the king's square
+    for(Bitboard squares = PAWN_ATTACKS[Us][sq]; squares;)
+        if(PieceOn(PopLsb(squares)) == pawn)        return true;
     return false;
+#endif
 }
 
-bool Chess::IsCheck(std::string &move) noexcept {
+bool Chess::IsCheck(const bool &turn) const noexcept {
+    return turn ? IsCheck<WHITE>() : IsCheck<BLACK>();
+}
+
+template<Color Us> bool Chess::IsCheck(std::string &move) noexcept {
     ChangeToRealCoordinates(move[0], move[1], move[2], move[3]);
+#ifdef COPY_MAKE
+    const BoardState state = GetState();
+#endif
     MovePiece(move[0], move[1], move[2], move[3], false, false);
-    const bool &is_check = IsCheck(!whites_turn);
+    const bool &is_check = IsCheck<Us>();
+#ifdef COPY_MAKE
+    MovePieceBack(state);
+#else
     MovePieceBack(move[0], move[1], move[2], move[3]);
+#endif
     ChangeToString(move[0], move[1], move[2], move[3]);
     return is_check;
 }
 
-std::forward_list<std::string> Chess::PawnMoves(const short &x, const short &y) const noexcept {
-    const auto &IsValid = whites_turn ? [](const char &ch){ return ch < 0; } : [](const char &ch){ return ch > 0; };
-    const short &inc = whites_turn ? -1 : 1;
+// When not in check, a move of any piece but the king (en passant aside) can only be illegal if that piece is pinned:
+// it has to leave a line it shares with its king while nothing stands between the two. Everything else is legal
+// without playing it out.
+template<Color Us> bool Chess::NeedsLegalityTest(const std::string &move, const short &king) const noexcept {
+    const short &from = ('8'-move[1])*BOARD_SIZE + move[0]-'a', &to = ('8'-move[3])*BOARD_SIZE + move[2]-'a';
+    if(from == king)
+        return true;
+    if(PieceOn(from) == MakePiece<Us>(W_PAWN) && move[0] != move[2] && PieceOn(to) == EMPTY)
+        return true;
+    if(!LINE[king][from] || (LINE[king][from] & (1ULL << to)))
+        return false;
+    for(Bitboard squares = BETWEEN[king][from]; squares;)
+        if(PieceOn(PopLsb(squares)) != EMPTY)
+            return false;
+    return true;
+}
+
+// adds the move to the list if the piece on the target square matches the generation type
+template<Color Us, GenType Type> void Chess::AddMove(const short &x1, const short &y1, const short &x2, const short &y2, std::forward_list<std::string> &all_moves) const noexcept {
+    if(board[Mailbox(x2, y2)] == EMPTY ? Type != CAPTURES : (Type != QUIETS && IsOpponentPiece<Us>(board[Mailbox(x2, y2)])))
+        all_moves.emplace_front(ToString(x1, y1, x2, y2));
+}
+
+// adds the moves along one ray, given as a mailbox step, until the first piece (which is included if it can be captured)
+template<Color Us, GenType Type> void Chess::AddSlidingMoves(const short &x, const short &y, const short &step, std::forward_list<std::string> &all_moves) const noexcept {
+    short to = Mailbox(x, y) + step;
+    for(; board[to] == EMPTY; to += step)
+        if(Type != CAPTURES)
+            all_moves.emplace_front(ToString(x, y, MailboxX(to), MailboxY(to)));
+    if(Type != QUIETS && IsOpponentPiece<Us>(board[to]))
+        all_moves.emplace_front(ToString(x, y, MailboxX(to), MailboxY(to)));
+}
+
+template<Color Us, GenType Type> std::forward_list<std::string> Chess::PawnMoves(const short &x, const short &y) const noexcept {
+    constexpr short inc = Us == WHITE ? -1 : 1;
+    constexpr short start_row = Us == WHITE ? BOARD_SIZE-2 : 1;
+    const short &ahead = Mailbox(x, y+inc);
     std::forward_list<std::string> all_moves;
-    if(board[y+inc][x] == EMPTY) {
+    if(Type != CAPTURES && board[ahead] == EMPTY) {
         all_moves.emplace_front(ToString(x, y, x, y+inc));
-        if((y == 1 + 5*whites_turn) && (board[y + 2*inc][x] == EMPTY))
+        if((y == start_row) && (board[ahead + inc*MAILBOX_WIDTH] == EMPTY))
             all_moves.emplace_front(ToString(x, y, x, y + 2*inc));
     }
-    if(GetEnPassant(x, y) != -1)
-        all_moves.emplace_front(ToString(x, y, GetEnPassant(x, y), y+inc));
-    if(IsValid(board[y+inc][x+1]) && (x < BOARD_SIZE-1))
-        all_moves.emplace_front(ToString(x, y, x+1, y+inc));
-    if(IsValid(board[y+inc][x-1]) && (x > 0))
-        all_moves.emplace_front(ToString(x, y, x-1, y+inc));
+    if(Type != QUIETS) {
+        const short &en_passant = GetEnPassant<Us>(x, y);
+        if(en_passant != -1)
+            all_moves.emplace_front(ToString(x, y, en_passant, y+inc));
+        if(IsOpponentPiece<Us>(board[ahead+1]))
+            all_moves.emplace_front(ToString(x, y, x+1, y+inc));
+        if(IsOpponentPiece<Us>(board[ahead-1]))
+            all_moves.emplace_front(ToString(x, y, x-1, y+inc));
+    }
     return all_moves;
 }
 
-std::forward_list<std::string> Chess::RookMoves(const short &x, const short &y) const noexcept {
-    const auto &IsValid = whites_turn ? [](const char &ch){ return ch < 0; } : [](const char &ch){ return ch > 0; };
+template<Color Us, GenType Type> std::forward_list<std::string> Chess::RookMoves(const short &x, const short &y) const noexcept {
     std::forward_list<std::string> all_moves;
-    for(short i=x+1;i<BOARD_SIZE;++i)
-        if(board[y][i] == EMPTY)
-            all_moves.emplace_front(ToString(x, y, i, y));
-        else {
-            if(IsValid(board[y][i]))
-                all_moves.emplace_front(ToString(x, y, i, y));
-            break;
-        }
-    for(short i=x-1;i>=0;--i)
-        if(board[y][i] == EMPTY)
-            all_moves.emplace_front(ToString(x, y, i, y));
-        else {
-            if(IsValid(board[y][i]))
-                all_moves.emplace_front(ToString(x, y, i, y));
-            break;
-        }
-    for(short i=y+1;i<BOARD_SIZE;++i)
-        if(board[i][x] == EMPTY)
-            all_moves.emplace_front(ToString(x, y, x, i));
-        else {
-            if(IsValid(board[i][x]))
-                all_moves.emplace_front(ToString(x, y, x, i));
-            break;
-        }
-    for(short i=y-1;i>=0;--i)
-        if(board[i][x] == EMPTY)
-            all_moves.emplace_front(ToString(x, y, x, i));
-        else {
-            if(IsValid(board[i][x]))
-                all_moves.emplace_front(ToString(x, y, x, i));
-            break;
-        }
+    for(const short &step : ROOK_DIRECTIONS)
+        AddSlidingMoves<Us, Type>(x, y, step, all_moves);
     return all_moves;
 }
 
-std::forward_list<std::string> Chess::KnightMoves(const short &x, const short &y) const noexcept {
-    const auto &IsValid = whites_turn ? [](const char &ch){ return ch <= 0; } : [](const char &ch){ return ch >= 0; };
+template<Color Us, GenType Type> std::forward_list<std::string> Chess::KnightMoves(const short &x, const short &y) const noexcept {
     std::forward_list<std::string> all_moves;
-    if(IsValid(board[y-1][x-2]) && (y > 0) && (x > 1))
-        all_moves.emplace_front(ToString(x, y, x-2, y-1));
-    if(IsValid(board[y-1][x+2]) && (y > 0) && (x < BOARD_SIZE-2))
-        all_moves.emplace_front(ToString(x, y, x+2, y-1));
-    if(IsValid(board[y+1][x-2]) && (y < BOARD_SIZE-1) && (x > 1))
-        all_moves.emplace_front(ToString(x, y, x-2, y+1));
-    if(IsValid(board[y+1][x+2]) && (y < BOARD_SIZE-1) && (x < BOARD_SIZE-2))
-        all_moves.emplace_front(ToString(x, y, x+2, y+1));
-    if(IsValid(board[y-2][x-1]) && (y > 1) && (x > 0))
-        all_moves.emplace_front(ToString(x, y, x-1, y-2));
-    if(IsValid(board[y-2][x+1]) && (y > 1) && (x < BOARD_SIZE-1))
-        all_moves.emplace_front(ToString(x, y, x+1, y-2));
-    if(IsValid(board[y+2][x-1]) && (y < BOARD_SIZE-2) && (x > 0))
-        all_moves.emplace_front(ToString(x, y, x-1, y+2));
-    if(IsValid(board[y+2][x+1]) && (y < BOARD_SIZE-2) && (x < BOARD_SIZE-1))
-        all_moves.emplace_front(ToString(x, y, x+1, y+2));
+    for(Bitboard squares = KNIGHT_ATTACKS[y*BOARD_SIZE + x]; squares;) {
+        const short &to = PopLsb(squares);
+        AddMove<Us, Type>(x, y, to % BOARD_SIZE, to / BOARD_SIZE, all_moves);
+    }
     return all_moves;
 }
 
-std::forward_list<std::string> Chess::BishopMoves(const short &x, const short &y) const noexcept {
-    const auto &IsValid = whites_turn ? [](const char &ch){ return ch < 0; } : [](const char &ch){ return ch > 0; };
+template<Color Us, GenType Type> std::forward_list<std::string> Chess::BishopMoves(const short &x, const short &y) const noexcept {
     std::forward_list<std::string> all_moves;
-    for(short i=x-1, j=y-1; i>=0 && j>=0; --i, --j)
-        if(board[j][i] == EMPTY)
-            all_moves.emplace_front(ToString(x, y, i, j));
-        else {
-            if(IsValid(board[j][i]))
-                all_moves.emplace_front(ToString(x, y, i, j));
-            break;
-        }
-    for(short i=x-1, j=y+1; i>=0 && j<BOARD_SIZE; --i, ++j)
-        if(board[j][i] == EMPTY)
-            all_moves.emplace_front(ToString(x, y, i, j));
-        else {
-            if(IsValid(board[j][i]))
-                all_moves.emplace_front(ToString(x, y, i, j));
-            break;
-        }
-    for(short i=x+1, j=y-1; i<BOARD_SIZE && j>=0; ++i, --j)
-        if(board[j][i] == EMPTY)
-            all_moves.emplace_front(ToString(x, y, i, j));
-        else {
-            if(IsValid(board[j][i]))
-                all_moves.emplace_front(ToString(x, y, i, j));
-            break;
-        }
-    for(short i=x+1, j=y+1; i<BOARD_SIZE && j<BOARD_SIZE; ++i, ++j)
-        if(board[j][i] == EMPTY)
-            all_moves.emplace_front(ToString(x, y, i, j));
-        else {
-            if(IsValid(board[j][i]))
-                all_moves.emplace_front(ToString(x, y, i, j));
-            break;
-        }
+    for(const short &step : BISHOP_DIRECTIONS)
+        AddSlidingMoves<Us, Type>(x, y, step, all_moves);
     return all_moves;
 }
 
-std::forward_list<std::string> Chess::QueenMoves(const short &x, const short &y) const noexcept {
-    auto all_moves = RookMoves(x, y);
-    all_moves.merge(BishopMoves(x, y));
+template<Color Us, GenType Type> std::forward_list<std::string> Chess::QueenMoves(const short &x, const short &y) const noexcept {
+    auto all_moves = RookMoves<Us, Type>(x, y);
+    all_moves.merge(BishopMoves<Us, Type>(x, y));
     return all_moves;
 }
 
-std::forward_list<std::string> Chess::KingMoves(const short &x, const short &y) const noexcept {
-    const auto &IsValid = whites_turn ? [](const char &ch){ return ch <= 0; } : [](const char &ch){ return ch >= 0; };
+template<Color Us, GenType Type> std::forward_list<std::string> Chess::KingMoves(const short &x, const short &y) const noexcept {
     std::forward_list<std::string> all_moves;
-    for(short i=x-1;i<x+2;++i)
-        for(short j=y-1;j<y+2;++j)
-            if(IsValid(board[j][i]) && WithinBounds(i) && WithinBounds(j))
-                all_moves.emplace_front(ToString(x, y, i, j));
-    if(GetCurrentPlayerConst().GetCastling())
-        if(!IsCheck(whites_turn)) {
-            const short &line = (BOARD_SIZE-1)*whites_turn;
-            if((board[line][0] == B_ROOK + 7*whites_turn) && board[line][1] == EMPTY && board[line][2] == EMPTY && board[line][3] == EMPTY)
-                all_moves.emplace_front(ToString(4, line, 2, line));
-            else if((board[line][7] == B_ROOK + 7*whites_turn) && board[line][5] == EMPTY && board[line][6] == EMPTY)
-                all_moves.emplace_front(ToString(4, line, 6, line));
-        }
+    for(Bitboard squares = KING_ATTACKS[y*BOARD_SIZE + x]; squares;) {
+        const short &to = PopLsb(squares);
+        AddMove<Us, Type>(x, y, to % BOARD_SIZE, to / BOARD_SIZE, all_moves);
+    }
+    // castling is never an evasion, and for NON_EVASIONS the caller has already established that the king is not in check
+    if constexpr(Type == QUIETS || Type == NON_EVASIONS)
+        if((Us == WHITE ? white : black).GetCastling())
+            if(Type == NON_EVASIONS || !IsCheck<Us>()) {
+                constexpr short line = Us == WHITE ? BOARD_SIZE-1 : 0;
+                constexpr char rook = MakePiece<Us>(W_ROOK);
+                if((board[Mailbox(0, line)] == rook) && board[Mailbox(1, line)] == EMPTY && board[Mailbox(2, line)] == EMPTY && board[Mailbox(3, line)] == EMPTY)
+                    all_moves.emplace_front(ToString(4, line, 2, line));
+                else if((board[Mailbox(7, line)] == rook) && board[Mailbox(5, line)] == EMPTY && board[Mailbox(6, line)] == EMPTY)
+                    all_moves.emplace_front(ToString(4, line, 6, line));
+            }
     return all_moves;
 }
 
-std::forward_list<std::string> Chess::AllMoves() noexcept {
+template<Color Us, GenType Type> std::forward_list<std::string> Chess::PieceMoves(const short &x, const short &y) const noexcept {
+    switch(board[Mailbox(x, y)]) {
+        case MakePiece<Us>(W_PAWN):      return PawnMoves<Us, Type>(x, y);
+        case MakePiece<Us>(W_ROOK):      return RookMoves<Us, Type>(x, y);
+        case MakePiece<Us>(W_KNIGHT):    return KnightMoves<Us, Type>(x, y);
+        case MakePiece<Us>(W_BISHOP):    return BishopMoves<Us, Type>(x, y);
+        case MakePiece<Us>(W_QUEEN):     return QueenMoves<Us, Type>(x, y);
+        case MakePiece<Us>(W_KING):      return KingMoves<Us, Type>(x, y);
+        default:                         return {};
+    }
+}
+
+template<Color Us, GenType Type> std::forward_list<std::string> Chess::GenerateMoves() noexcept {
     std::forward_list<std::string> all_moves;
-    for(short y=0;y<BOARD_SIZE;++y)
-        for(short x=0;x<BOARD_SIZE;++x) {
-            if((board[y][x] < 0) == whites_turn)
-                continue;
-            switch(board[y][x]) {
-                case W_PAWN:
-                case B_PAWN:
-                    all_moves.merge(PawnMoves(x, y));
-                    break;
-                case W_ROOK:
-                case B_ROOK:
-                    all_moves.merge(RookMoves(x, y));
-                    break;
-                case W_KNIGHT:
-                case B_KNIGHT:
-                    all_moves.merge(KnightMoves(x, y));
-                    break;
-                case W_BISHOP:
-                case B_BISHOP:
-                    all_moves.merge(BishopMoves(x, y));
-                    break;
-                case W_QUEEN:
-                case B_QUEEN:
-                    all_moves.merge(QueenMoves(x, y));
-                    break;
-                case W_KING:
-                case B_KING:
-                    all_moves.merge(KingMoves(x, y));
-            }
-        }
+    for(char piece=W_KING;piece<=W_PAWN;++piece) {
+        const short &group = MakePiece<Us>(piece) - B_KING;
+        for(unsigned char i=0;i<piece_lists.count[group];++i)
+            all_moves.merge(PieceMoves<Us, Type>(piece_lists.squares[group][i] % BOARD_SIZE, piece_lists.squares[group][i] / BOARD_SIZE));
+    }
+    const bool &in_check = Type == EVASIONS || (Type != NON_EVASIONS && IsCheck<Us>());
+    const short &king = KingSquare<Us>();
     for(auto it = all_moves.begin(), prev = all_moves.before_begin(); it != all_moves.cend();)        // if the possible move makes me checkmate after the opponent's turn, remove it from the list
-        if(IsCheck(*it))
+        if((in_check || NeedsLegalityTest<Us>(*it, king)) && IsCheck<Us>(*it))
             it = all_moves.erase_after(prev);
         else
             ++it, ++prev;
     return all_moves;
 }
 
-std::string Chess::GetRandomMove() noexcept {
-    auto all_moves = AllMoves();
-    auto move = all_moves.begin();
-    advance(move, GetRandomNumber<unsigned short>(0, distance(all_moves.cbegin(), all_moves.cend()) - 1));
-    ChangeToRealCoordinates((*move)[0], (*move)[1], (*move)[2], (*move)[3]);
-    return *move;
+template<GenType Type> std::forward_list<std::string> Chess::AllMoves() noexcept {
+    return whites_turn ? GenerateMoves<WHITE, Type>() : GenerateMoves<BLACK, Type>();
 }
 
-void Chess::ManuallyPromotePawn(const short &x, const short &y) noexcept {
-    MoveCursorToXY(RIGHT, DOWN + 3*BOARD_SIZE + 7);
-    std::cout << "Enter your choice of promotion [(r)ook, (k)night, (b)ishop, (q)ueen]";
-    char key = getch();
-    while(true)
-        switch(key = tolower(key)) {
-            case 'r':    board[y][x] = whites_turn ? W_ROOK : B_ROOK;        return;
-            case 'k':    board[y][x] = whites_turn ? W_KNIGHT : B_KNIGHT;    return;
-            case 'b':    board[y][x] = whites_turn ? W_BISHOP : B_BISHOP;    return;
-            case 'q':    board[y][x] = whites_turn ? W_QUEEN : B_QUEEN;        return;
-            default:    key = getch();
-        }
+std::forward_list<std::string> Chess::AllMoves() noexcept {
+    if(whites_turn)
+        return IsCheck<WHITE>() ? GenerateMoves<WHITE, EVASIONS>() : GenerateMoves<WHITE, NON_EVASIONS>();
+    return IsCheck<BLACK>() ? GenerateMoves<BLACK, EVASIONS>() : GenerateMoves<BLACK, NON_EVASIONS>();
+}
+
+// like GenerateMoves, but stops at the first legal move instead of building and filtering the whole list
+template<Color Us, GenType Type> bool Chess::HasLegalMove() noexcept {
+    const short &king = KingSquare<Us>();
+    for(const ChessPieces &piece : {W_QUEEN, W_ROOK, W_BISHOP, W_KNIGHT, W_PAWN, W_KING}) {        // the king last, as its moves always need a legality test
+        // a promotion tried by IsCheck puts the pawn back at the end of its group, so walk over a copy
+        const short &group = MakePiece<Us>(piece) - B_KING;
+        unsigned char squares[16];
+        const unsigned char count = piece_lists.count[group];
+        std::copy(piece_lists.squares[group], piece_lists.squares[group] + count, squares);
+        for(unsigned char i=0;i<count;++i)
+            for(auto &move : PieceMoves<Us, Type>(squares[i] % BOARD_SIZE, squares[i] / BOARD_SIZE))
+                if(!((Type == EVASIONS || NeedsLegalityTest<Us>(move, king)) && IsCheck<Us>(move)))
+                    return true;
+    }
+    return false;
+}
+
+bool Chess::HasLegalMove() noexcept {
+    if(whites_turn)
+        return IsCheck<WHITE>() ? HasLegalMove<WHITE, EVASIONS>() : HasLegalMove<WHITE, NON_EVASIONS>();
+    return IsCheck<BLACK>() ? HasLegalMove<BLACK, EVASIONS>() : HasLegalMove<BLACK, NON_EVASIONS>();
+}
+
+// whether the side to move is in check
+bool Chess::IsCheck() const noexcept {
+    return whites_turn ? IsCheck<WHITE>() : IsCheck<BLACK>();
+}
+
+// neither side can mate with the material left: bare kings, a single minor piece, or only bishops on same-colored squares
+bool Chess::IsInsufficientMaterial() const noexcept {
+    for(const ChessPieces &piece : {W_QUEEN, W_ROOK, W_PAWN})
+        if(PieceCount<WHITE>(piece) || PieceCount<BLACK>(piece))
+            return false;
+    const short &minor_pieces = PieceCount<WHITE>(W_KNIGHT) + PieceCount<BLACK>(W_KNIGHT) + PieceCount<WHITE>(W_BISHOP) + PieceCount<BLACK>(W_BISHOP);
+    short bishop_square_colors[2] = {0, 0};
+    for(const ChessPieces &bishop : {W_BISHOP, B_BISHOP})
+        for(unsigned char i=0;i<piece_lists.count[bishop - B_KING];++i)
+            ++bishop_square_colors[(piece_lists.squares[bishop - B_KING][i] / BOARD_SIZE + piece_lists.squares[bishop - B_KING][i] % BOARD_SIZE) % 2];
+    return minor_pieces <= 1 || minor_pieces == bishop_square_colors[0] || minor_pieces == bishop_square_colors[1];
+}
+
+// a castling, promotion, en passant capture, pawn move or capture, after which no earlier position can come back
+bool Chess::IsIrreversible(const std::pair<Moves, std::string> &game_move) noexcept {
+    return game_move.first != NORMAL || game_move.second[4] == W_PAWN || game_move.second[4] == B_PAWN || game_move.second[5] != EMPTY;
+}
+
+bool Chess::LastMoveWasIrreversible() const noexcept {
+    return !all_game_moves.empty() && IsIrreversible(all_game_moves.back());
+}
+
+// counts the earlier occurrences of the current position, looking back no further than the last irreversible move
+unsigned short Chess::RepetitionCount() const noexcept {
+    const HashKey &key = GetKey();
+    unsigned short count = 0;
+    for(size_t i=all_game_moves.size(); i-- > 0;) {
+        if(IsIrreversible(all_game_moves[i]))
+            break;
+        if((all_game_moves.size() - i) % 2 == 0 && position_keys[i] == key)
+            ++count;
+    }
+    return count;
+}
+
+std::string Chess::GetRandomMove() noexcept {
+    auto all_moves = AllMoves();
+    auto move = all_moves.begin();
+    advance(move, GetRandomNumber<unsigned short>(0, distance(all_moves.cbegin(), all_moves.cend()) - 1));
+    ChangeToRealCoordinates((*move)[0], (*move)[1], (*move)[2], (*move)[3]);
+    return *move;
+}
+
+void Chess::ManuallyPromotePawn(const short &x, const short &y) noexcept {
+    MoveCursorToXY(RIGHT, DOWN + 3*BOARD_SIZE + 7);
+    std::cout << "Enter your choice of promotion [(r)ook, (k)night, (b)ishop, (q)ueen]";
+    char key = getch();
+    while(true)
+        switch(key = tolower(key)) {
+            case 'r':    SetPiece(x, y, whites_turn ? W_ROOK : B_ROOK);        return;
+            case 'k':    SetPiece(x, y, whites_turn ? W_KNIGHT : B_KNIGHT);    return;
+            case 'b':    SetPiece(x, y, whites_turn ? W_BISHOP : B_BISHOP);    return;
+            case 'q':    SetPiece(x, y, whites_turn ? W_QUEEN : B_QUEEN);        return;
+            default:    key = getch();
+        }
 }
 
 void Chess::MovePiece(const short &x1, const short &y1, const short &x2, const short &y2, const bool &manual_promotion, const bool &update_board) noexcept {
+    position_keys.push_back(GetKey());
     AppendToAllGameMoves(x1, y1, x2, y2);
-    switch(board[y1][x1]) {
+    switch(board[Mailbox(x1, y1)]) {
         case W_PAWN:
         case B_PAWN:
             if(y2 == ((BOARD_SIZE-1) * !whites_turn)) {
@@ -768,14 +2210,14 @@ void Chess::MovePiece(const short &x1, const short &y1, const short &x2, const s
                     std::cout << "All possible moves:" << CLEAR_LINE;
                 }
                 else if(whites_turn ? white_bot_random : black_bot_random)
-                    board[y1][x1] = (whites_turn ? 1 : -1) * GetRandomNumber(2, 5);
+                    SetPiece(x1, y1, (whites_turn ? 1 : -1) * GetRandomNumber(2, 5));
                 else
-                    board[y1][x1] = whites_turn ? W_QUEEN : B_QUEEN;
+                    SetPiece(x1, y1, whites_turn ? W_QUEEN : B_QUEEN);
                 all_game_moves.back().first = PROMOTION;
-                all_game_moves.back().second.push_back(board[y1][x1]);
+                all_game_moves.back().second.push_back(board[Mailbox(x1, y1)]);
             }
-            else if(x1 != x2 && board[y2][x2] == EMPTY) {
-                board[y1][x2] = EMPTY;
+            else if(x1 != x2 && board[Mailbox(x2, y2)] == EMPTY) {
+                SetPiece(x2, y1, EMPTY);
                 if(update_board) {
                     GetCurrentPlayer().IncreaseScore(EvaluatePiece(W_PAWN));
                     UpdateScore(GetCurrentPlayerConst());
@@ -790,14 +2232,14 @@ void Chess::MovePiece(const short &x1, const short &y1, const short &x2, const s
                 const short &line = (BOARD_SIZE-1) * whites_turn;
                 switch(x2) {
                     case 2:
-                        board[line][3] = board[line][0], board[line][0] = EMPTY;
+                        SetPiece(3, line, board[Mailbox(0, line)]), SetPiece(0, line, EMPTY);
                         if(update_board) {
                             UpdateBoard(0, line);
                             UpdateBoard(3, line);
                         }
                         break;
                     case 6:
-                        board[line][5] = board[line][7], board[line][7] = EMPTY;
+                        SetPiece(5, line, board[Mailbox(7, line)]), SetPiece(7, line, EMPTY);
                         if(update_board) {
                             UpdateBoard(7, line);
                             UpdateBoard(5, line);
@@ -809,7 +2251,7 @@ void Chess::MovePiece(const short &x1, const short &y1, const short &x2, const s
             GetCurrentPlayer().SetCastling(false);
     }
     if(all_game_moves.back().first != CASTLING)                all_game_moves.back().second.push_back(GetCurrentPlayerConst().GetCastling());
-    board[y2][x2] = board[y1][x1], board[y1][x1] = EMPTY;
+    SetPiece(x2, y2, board[Mailbox(x1, y1)]), SetPiece(x1, y1, EMPTY);
     if(update_board) {
         if(all_game_moves.back().first != CASTLING)
             if(all_game_moves.back().second[5] != EMPTY) {
@@ -825,23 +2267,22 @@ void Chess::MovePiece(const short &x1, const short &y1, const short &x2, const s
 
 void Chess::MovePieceBack(const short &x1, const short &y1, const short &x2, const short &y2) noexcept {
     ChangeTurn();
-    board[y1][x1] = board[y2][x2], board[y2][x2] = all_game_moves.back().first == CASTLING ? static_cast<char>(EMPTY) : all_game_moves.back().second[5];
-    switch(board[y1][x1]) {
+    SetPiece(x1, y1, board[Mailbox(x2, y2)]), SetPiece(x2, y2, all_game_moves.back().first == CASTLING ? static_cast<char>(EMPTY) : all_game_moves.back().second[5]);
+    switch(board[Mailbox(x1, y1)]) {
         case W_PAWN:
         case B_PAWN:
-            if(x1 != x2 && board[y2][x2] == EMPTY)
-                board[y1][x2] = whites_turn ? B_PAWN : W_PAWN;
+            if(x1 != x2 && board[Mailbox(x2, y2)] == EMPTY)
+                SetPiece(x2, y1, whites_turn ? B_PAWN : W_PAWN);
             break;
         case W_ROOK:
         case B_ROOK:
-            if(prev(all_game_moves.cend(), 3)->first != CASTLING)
-                if(prev(all_game_moves.cend(), 3)->second[6 + (prev(all_game_moves.cend(), 3)->first == PROMOTION)])
-                    GetCurrentPlayer().SetCastling(true);
+            if(CouldCastleBeforeLastMove())
+                GetCurrentPlayer().SetCastling(true);
             break;
         case W_QUEEN:
         case B_QUEEN:
             if(all_game_moves.back().first == PROMOTION)
-                board[y1][x1] = whites_turn ? W_PAWN : B_PAWN;
+                SetPiece(x1, y1, whites_turn ? W_PAWN : B_PAWN);
             break;
         case W_KING:
         case B_KING:
@@ -850,23 +2291,219 @@ void Chess::MovePieceBack(const short &x1, const short &y1, const short &x2, con
                 const short line = (BOARD_SIZE-1) * whites_turn;
                 switch(x2) {
                     case 2:
-                        board[line][0] = board[line][3], board[line][3] = EMPTY;
+                        SetPiece(0, line, board[Mailbox(3, line)]), SetPiece(3, line, EMPTY);
                         break;
                     case 6:
-                        board[line][5] = board[line][7], board[line][7] = EMPTY;
+                        SetPiece(7, line, board[Mailbox(5, line)]), SetPiece(5, line, EMPTY);
                 }
             }
-            else if(prev(all_game_moves.cend(), 3)->first != CASTLING)
-                if(prev(all_game_moves.cend(), 3)->second[6 + (prev(all_game_moves.cend(), 3)->first == PROMOTION)])
-                    GetCurrentPlayer().SetCastling(true);
+            else if(CouldCastleBeforeLastMove())
+                GetCurrentPlayer().SetCastling(true);
     }
     all_game_moves.pop_back();
+    position_keys.pop_back();
+}
+
+// Whether the player whose move is being taken back could castle before it, as recorded with their move before that.
+// Without one, the rights the recorded moves started from apply.
+bool Chess::CouldCastleBeforeLastMove() const noexcept {
+    if(all_game_moves.size() < 3)
+        return start_castling[whites_turn];
+    const auto &previous_move = *prev(all_game_moves.cend(), 3);
+    return previous_move.first != CASTLING && previous_move.second[6 + (previous_move.first == PROMOTION)];
+}
+
+BoardState Chess::GetState() const noexcept {
+    BoardState state;
+    CopyBoard(board, state.board);
+    state.whites_turn = whites_turn;
+    state.white_castling = white.GetCastling(), state.black_castling = black.GetCastling();
+    state.piece_key = piece_key;
+    state.evaluation = evaluation;
+    state.piece_lists = piece_lists;
+#ifdef ATTACK_TABLES
+    state.attacks = attacks;
+#endif
+    return state;
+}
+
+// copy-make counterpart of MovePieceBack: restores the state saved before the last MovePiece
+void Chess::MovePieceBack(const BoardState &state) noexcept {
+    CopyBoard(state.board, board);
+    whites_turn = state.whites_turn;
+    white.SetCastling(state.white_castling), black.SetCastling(state.black_castling);
+    piece_key = state.piece_key;
+    evaluation = state.evaluation;
+    piece_lists = state.piece_lists;
+#ifdef ATTACK_TABLES
+    attacks = state.attacks;
+#endif
+    all_game_moves.pop_back();
+    position_keys.pop_back();
+}
+
+// Sets up the position of a FEN string and forgets the moves so far; returns false, leaving the game as it was, if the
+// string is malformed or the side not to move is in check. This engine keeps one castling right per color: it is granted
+// when the FEN gives the color any right and its king and a rook still stand where castling needs them. An en passant
+// square is recorded as the double pawn step that made it possible.
+bool Chess::SetPosition(const std::string &fen) noexcept {
+    std::vector<std::string> fields;
+    for(size_t begin = 0, end; begin < fen.length(); begin = end + 1) {
+        end = fen.find(' ', begin);
+        if(end == std::string::npos)
+            end = fen.length();
+        if(end > begin)
+            fields.push_back(fen.substr(begin, end - begin));
+    }
+    if(fields.size() < 4 || (fields[1] != "w" && fields[1] != "b"))
+        return false;
+    char new_board[BOARD_SIZE][BOARD_SIZE];
+    short x = 0, y = 0, kings[2] = {0, 0};
+    for(const char &letter : fields[0]) {
+        const size_t &kind = std::string("KQBNRP").find(toupper(letter));
+        if(letter == '/') {
+            if(x != BOARD_SIZE || ++y == BOARD_SIZE)
+                return false;
+            x = 0;
+        }
+        else if(letter >= '1' && letter <= '8' && x + letter - '0' <= BOARD_SIZE)
+            for(short i=0;i<letter-'0';++i)
+                new_board[y][x++] = EMPTY;
+        else if(kind != std::string::npos && x < BOARD_SIZE && (toupper(letter) != 'P' || (y > 0 && y < BOARD_SIZE-1))) {
+            new_board[y][x++] = (isupper(letter) ? W_KING : B_KING) + static_cast<short>(kind);
+            kings[isupper(letter) ? WHITE : BLACK] += !kind;
+        }
+        else
+            return false;
+    }
+    if(x != BOARD_SIZE || y != BOARD_SIZE-1 || kings[WHITE] != 1 || kings[BLACK] != 1)
+        return false;
+    const bool &white_to_move = fields[1] == "w";
+    short en_passant = -1;
+    if(fields[3] != "-") {
+        en_passant = fields[3][0] - 'a';
+        if(fields[3].length() != 2 || !WithinBounds(en_passant) || fields[3][1] != (white_to_move ? '6' : '3')
+           || new_board[white_to_move ? 3 : BOARD_SIZE-4][en_passant] != (white_to_move ? B_PAWN : W_PAWN))
+            return false;
+    }
+    Chess position("", 0, "", 0);
+    position.SetUpBoard(new_board);
+    if(position.IsCheck(!white_to_move))
+        return false;
+    bool castling[2];
+    for(const Color &color : {BLACK, WHITE}) {
+        const short &line = color == WHITE ? BOARD_SIZE-1 : 0;
+        const char &rook = color == WHITE ? W_ROOK : B_ROOK;
+        const bool &rights = fields[2].find_first_of(color == WHITE ? "KQ" : "kq") != std::string::npos;
+        castling[color] = rights && new_board[line][4] == (color == WHITE ? W_KING : B_KING) && (new_board[line][0] == rook || new_board[line][7] == rook);
+    }
+    LoadPosition(new_board, white_to_move, castling, en_passant);
+    moves_after_last_pawn_move_or_capture = fields.size() > 4 ? atoi(fields[4].c_str()) : 0;
+    return true;
+}
+
+// sets up a position from a record of GetCompactPosition and forgets the moves so far
+void Chess::SetPosition(const CompactPosition &position) noexcept {
+    char new_board[BOARD_SIZE][BOARD_SIZE];
+    for(short y=0;y<BOARD_SIZE;++y)
+        for(short x=0;x<BOARD_SIZE;++x)
+            new_board[y][x] = static_cast<char>(position.position.ranks[y] >> 4*x & 0xF) + B_KING;
+    LoadPosition(new_board, position.position.whites_turn, position.castling, position.en_passant);
+    moves_after_last_pawn_move_or_capture = 0;
+}
+
+CompactPosition Chess::GetCompactPosition() const noexcept {
+    return {Pack(), {black.GetCastling(), white.GetCastling()}, static_cast<signed char>(GetEnPassantFile())};
+}
+
+// sets up a valid position; en_passant is the file of a pawn that has just made a double step, or -1
+void Chess::LoadPosition(const char new_board[BOARD_SIZE][BOARD_SIZE], const bool &white_to_move, const bool castling[2], const short &en_passant) noexcept {
+    SetUpBoard(new_board);
+    whites_turn = white_to_move;
+    for(const Color &color : {BLACK, WHITE}) {
+        start_castling[color] = castling[color];
+        (color == WHITE ? white : black).SetCastling(castling[color]);
+    }
+    all_game_moves.clear();
+    position_keys.clear();
+    if(en_passant != -1) {
+        position_keys.push_back(0);
+        all_game_moves.emplace_back(NORMAL, ToString(en_passant, whites_turn ? 1 : BOARD_SIZE-2, en_passant, whites_turn ? 3 : BOARD_SIZE-4)
+                                    + static_cast<char>(whites_turn ? B_PAWN : W_PAWN) + static_cast<char>(EMPTY) + static_cast<char>(start_castling[!whites_turn]));
+    }
+}
+
+// plays a move given in coordinate notation (e.g. "e2e4") without touching the terminal; returns false if it is illegal
+bool Chess::PlayMove(std::string move) noexcept {
+    if(move.length() < 4)
+        return false;
+    ChangeToRealCoordinates(move[0], move[1], move[2], move[3]);
+    if(!WithinBounds(move[0]) || !WithinBounds(move[1]) || !WithinBounds(move[2]) || !WithinBounds(move[3]))
+        return false;
+    if(!CanMovePiece(move[0], move[1], move[2], move[3], AllMoves()))
+        return false;
+    MovePiece(move[0], move[1], move[2], move[3], false, false);
+    return true;
+}
+
+// Key of the position together with the positions since the last irreversible move, which the search looks at to
+// score repetitions as draws. Equal search keys mean equal search results.
+HashKey Chess::GetSearchKey() const noexcept {
+    HashKey key = GetKey();
+    for(size_t i=all_game_moves.size(); i-- > 0;) {
+        if(IsIrreversible(all_game_moves[i]))
+            break;
+        key = (key ^ position_keys[i]) * 0x9E3779B97F4A7C15ULL;
+    }
+    return key ? key : 1;
+}
+
+// Counts the leaf nodes of the legal move tree of the given depth, for validating and benchmarking move generation.
+// The last ply is bulk counted from the move list, and subtree sizes are cached in the optional table.
+unsigned long long Chess::Perft(const unsigned short &depth, PerftTable *table) noexcept {
+    if(!depth)
+        return 1;
+    auto all_moves = AllMoves();
+    if(depth == 1)
+        return distance(all_moves.cbegin(), all_moves.cend());
+    unsigned long long leaf_nodes = 0;
+    const HashKey &key = table ? GetKey() : 0;
+    if(table && table->Probe(key, depth, leaf_nodes))
+        return leaf_nodes;
+    for(auto &move : all_moves) {
+        ChangeToRealCoordinates(move[0], move[1], move[2], move[3]);
+#ifdef COPY_MAKE
+        const BoardState state = GetState();
+#endif
+        MovePiece(move[0], move[1], move[2], move[3], false, false);
+        leaf_nodes += Perft(depth-1, table);
+#ifdef COPY_MAKE
+        MovePieceBack(state);
+#else
+        MovePieceBack(move[0], move[1], move[2], move[3]);
+#endif
+    }
+    if(table)
+        table->Store(key, depth, leaf_nodes);
+    return leaf_nodes;
+}
+
+unsigned long long Chess::GetNodes() const noexcept {
+    return nodes;
+}
+
+void Chess::IncreaseNodes() noexcept {
+    ++nodes;
+}
+
+void Chess::ResetNodes() noexcept {
+    nodes = 0;
 }
 
 void Chess::UpdateBoard(const short &x, const short &y) const noexcept {
-    const unsigned short &diff = BOX_WIDTH - PieceNameToString(board[y][x]).length();
+    const unsigned short &diff = BOX_WIDTH - PieceNameToString(board[Mailbox(x, y)]).length();
     MoveCursorToXY(RIGHT + (BOX_WIDTH+1)*x, DOWN + 3*y + 1);
-    std::cout << std::string(diff/2, ' ') << PieceNameToString(board[y][x]) << std::string(diff/2, ' ');
+    std::cout << std::string(diff/2, ' ') << PieceNameToString(board[Mailbox(x, y)]) << std::string(diff/2, ' ');
     if(diff%2)    std::cout << " ";
 }
 
@@ -878,72 +2515,144 @@ void Chess::UpdateScore(const Bot &p) const noexcept {
     std::cout << p.GetScore();
 }
 
-float Chess::EvaluatePosition(const short &x, const short &y) const noexcept {
-    if(board[y][x] == EMPTY)
-        return 0;
-    static float PIECE_POS_POINTS[6][BOARD_SIZE][BOARD_SIZE] =
-    {{{-3.0, -4.0, -4.0, -5.0, -5.0, -4.0, -4.0, -3.0},
-    {-3.0, -4.0, -4.0, -5.0, -5.0, -4.0, -4.0, -3.0},
-    {-3.0, -4.0, -4.0, -5.0, -5.0, -4.0, -4.0, -3.0},
-    {-3.0, -4.0, -4.0, -5.0, -5.0, -4.0, -4.0, -3.0},
-    {-2.0, -3.0, -3.0, -4.0, -4.0, -3.0, -3.0, -2.0},
-    {-1.0, -2.0, -2.0, -2.0, -2.0, -2.0, -2.0, -1.0},
-    {2.0, 2.0, 0.0, 0.0, 0.0, 0.0, 2.0, 2.0},
-    {2.0, 3.0, 1.0, 0.0, 0.0, 1.0, 3.0, 2.0}}
-    ,
-    {{-2.0, -1.0, -1.0, -0.5, -0.5, -1.0, -1.0, -2.0},
-    {-1.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, -1.0},
-    {-1.0, 0.0, 0.5, 0.5, 0.5, 0.5, 0.0, -1.0},
-    {-0.5, 0.0, 0.5, 0.5, 0.5, 0.5, 0.0, -0.5},
-    {0.0, 0.0, 0.5, 0.5, 0.5, 0.5, 0.0, -0.5},
-    {-1.0, 0.5, 0.5, 0.5, 0.5, 0.5, 0.0, -1.0},
-    {-1.0, 0.0, 0.5, 0.0, 0.0, 0.0, 0.0, -1.0},
-    {-2.0, -1.0, -1.0, -0.5, -0.5, -1.0, -1.0, -2.0}}
-    ,
-    {{-2.0, -1.0, -1.0, -1.0, -1.0, -1.0, -1.0, -2.0},
-    {-1.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, -1.0},
-    {-1.0, 0.0, 0.5, 1.0, 1.0, 0.5, 0.0, -1.0},
-    {-1.0, 0.5, 0.5, 1.0, 1.0, 0.5, 0.5, -1.0},
-    {-1.0, 0.0, 1.0, 1.0, 1.0, 1.0, 0.0, -1.0},
-    {-1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, -1.0},
-    {-1.0, 0.5, 0.0, 0.0, 0.0, 0.0, 0.5, -1.0},
-    {-2.0, -1.0, -1.0, -1.0, -1.0, -1.0, -1.0, -2.0}}
-    ,
-    {{-5.0, -4.0, -3.0, -3.0, -3.0, -3.0, -4.0, -5.0},
-    {-4.0, -2.0, 0.0, 0.0, 0.0, 0.0, -2.0, -4.0},
-    {-3.0, 0.0, 1.0, 1.5, 1.5, 1.0, 0.0, -3.0},
-    {-3.0, 0.5, 1.5, 2.0, 2.0, 1.5, 0.5, -3.0},
-    {-3.0, 0.0, 1.5, 2.0, 2.0, 1.5, 0.0, -3.0},
-    {-3.0, 0.5, 1.0, 1.5, 1.5, 1.0, 0.5, -3.0},
-    {-4.0, -2.0, 0.0, 0.5, 0.5, 0.0, -2.0, -4.0},
-    {-5.0, -4.0, -3.0, -3.0, -3.0, -3.0, -4.0, -5.0}}
-    ,
-    {{0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0},
-    {0.5, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 0.5},
-    {-0.5, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, -0.5},
-    {-0.5, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, -0.5},
-    {-0.5, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, -0.5},
-    {-0.5, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, -0.5},
-    {-0.5, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, -0.5},
-    {0.0, 0.0, 0.0, 0.5, 0.5, 0.0, 0.0, 0.0}}
-    ,
-    {{0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0},
-    {5.0, 5.0, 5.0, 5.0, 5.0, 5.0, 5.0, 5.0},
-    {1.0, 1.0, 2.0, 3.0, 3.0, 2.0, 1.0, 1.0},
-    {0.5, 0.5, 1.0, 2.5, 2.5, 1.0, 0.5, 0.5},
-    {0.0, 0.0, 0.0, 2.0, 2.0, 0.0, 0.0, 0.0},
-    {0.5, -0.5, -1.0, 0.0, 0.0, -1.0, -0.5, 0.5},
-    {0.5, 1.0, 1.0, -2.0, -2.0, 1.0, 1.0, 0.5},
-    {0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0}}};
-    return (board[y][x]<0 ? -1 : 1) * (EvaluatePiece(board[y][x]) + PIECE_POS_POINTS[board[y][x] + 7*(board[y][x]<0) - 1][board[y][x]<0 ? BOARD_SIZE-y-1 : y][x]);
+// The evaluation table sum is updated by every SetPiece, so a leaf costs nothing to evaluate. The table entries are
+// multiples of 0.5, which floats add and subtract exactly, so the sum never drifts from a full re-evaluation.
+template<Color Us> float Chess::EvaluateBoard() const noexcept {
+    return Us == WHITE ? evaluation : -evaluation;
 }
 
 float Chess::EvaluateBoard(const bool &turn) const noexcept {
+    return turn ? EvaluateBoard<WHITE>() : EvaluateBoard<BLACK>();
+}
+
+// Guesses how good a move in real coordinates is for the side to move, in half points and without playing it: the
+// evaluation it gains (the piece-square change of the mover, a captured piece, a queen for a promoted pawn), less what
+// the mover may lose on its new square. An attacked mover loses all of its worth if nothing defends the square, and
+// otherwise what it is worth more than the cheapest attacker. 'occupied' is the Occupancy() of the board.
+template<Color Us> short Chess::ScoreMove(const std::string &move, const Bitboard &occupied) const noexcept {
+    const short &from = move[1]*BOARD_SIZE + move[0], &to = move[3]*BOARD_SIZE + move[2];
+    const char &piece = PieceOn(from), &captured = PieceOn(to);
+    const char &arriving = piece == MakePiece<Us>(W_PAWN) && move[3] == (Us == WHITE ? 0 : BOARD_SIZE-1) ? MakePiece<Us>(W_QUEEN) : piece;
+    const float &change = EVALUATION_TABLE[arriving - B_KING][to] - EVALUATION_TABLE[piece - B_KING][from] - EVALUATION_TABLE[captured - B_KING][to];
+    float gain = Us == WHITE ? change : -change;
+    const Bitboard &after = occupied & ~(1ULL << from);
+    char attacker, defender;
+    if(ScanAttackers<Opposite(Us)>(to, after, attacker))
+        gain -= ScanAttackers<Us>(to, after, defender) ? std::max(EvaluatePiece(arriving) - EvaluatePiece(attacker), 0.0f) : EvaluatePiece(arriving);
+    return static_cast<short>(2 * gain);
+}
+
+short Chess::ScoreMove(const std::string &move, const Bitboard &occupied) const noexcept {
+    return whites_turn ? ScoreMove<WHITE>(move, occupied) : ScoreMove<BLACK>(move, occupied);
+}
+
+// material plus piece-square points of every piece on every square from white's point of view, indexed [piece - B_KING][square]
+const std::array<std::array<float, BOARD_SIZE*BOARD_SIZE>, 13> Chess::EVALUATION_TABLE = Chess::GenerateEvaluationTable();
+
+std::array<std::array<float, BOARD_SIZE*BOARD_SIZE>, 13> Chess::GenerateEvaluationTable() noexcept {
+    std::array<std::array<float, BOARD_SIZE*BOARD_SIZE>, 13> table{};
+    for(char piece=W_KING;piece<=W_PAWN;++piece)
+        for(short y=0;y<BOARD_SIZE;++y)
+            for(short x=0;x<BOARD_SIZE;++x) {
+                table[piece - B_KING][y*BOARD_SIZE + x] = EvaluatePiece(piece) + PIECE_POS_POINTS[piece-1][y][x];
+                table[piece - 7 - B_KING][y*BOARD_SIZE + x] = -(EvaluatePiece(piece) + PIECE_POS_POINTS[piece-1][BOARD_SIZE-y-1][x]);
+            }
+    return table;
+}
+
+// Evaluates a whole board from white's point of view without looking at piece lists, given its first rank and the
+// distance between ranks (MAILBOX_WIDTH for the padded board, BOARD_SIZE for a plain one). With AVX2 every rank is
+// widened to eight piece codes and its table entries fetched by one gather; otherwise it is a plain loop over the table.
+float Chess::EvaluateSquares(const char *first_rank, const short &rank_stride) noexcept {
+#ifdef __AVX2__
+    const __m256i &files = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i &piece_offset = _mm256_set1_epi32(-B_KING);
+    __m256 sum = _mm256_setzero_ps();
+    for(short y=0;y<BOARD_SIZE;++y) {
+        const __m256i &pieces = _mm256_cvtepi8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(first_rank + y*rank_stride)));
+        const __m256i &squares = _mm256_add_epi32(files, _mm256_set1_epi32(y*BOARD_SIZE));
+        const __m256i &index = _mm256_add_epi32(_mm256_slli_epi32(_mm256_add_epi32(pieces, piece_offset), 6), squares);
+        sum = _mm256_add_ps(sum, _mm256_i32gather_ps(EVALUATION_TABLE[0].data(), index, sizeof(float)));
+    }
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    return _mm_cvtss_f32(_mm_add_ss(half, _mm_shuffle_ps(half, half, 1)));
+#else
     float total_evaluation = 0.0;
     for(short y=0;y<BOARD_SIZE;++y)
         for(short x=0;x<BOARD_SIZE;++x)
-            total_evaluation += EvaluatePosition(x, y);
-    return (turn ? 1 : -1) * total_evaluation;
+            total_evaluation += EVALUATION_TABLE[first_rank[y*rank_stride + x] - B_KING][y*BOARD_SIZE + x];
+    return total_evaluation;
+#endif
+}
+
+// full re-evaluation of the board, which has to agree with the incremental evaluation of EvaluateBoard
+float Chess::EvaluateAllSquares(const bool &turn) const noexcept {
+    const float &evaluation = EvaluateSquares(board + Mailbox(0, 0), MAILBOX_WIDTH);
+    return turn ? evaluation : -evaluation;
+}
+
+PackedPosition Chess::Pack() const noexcept {
+    PackedPosition packed = {};
+    for(short y=0;y<BOARD_SIZE;++y)
+        for(short x=0;x<BOARD_SIZE;++x)
+            packed.ranks[y] |= static_cast<unsigned int>(board[Mailbox(x, y)] - B_KING) << 4*x;
+    packed.whites_turn = whites_turn;
+    return packed;
+}
+
+// Evaluates packed positions on the calling thread, each from the point of view of its side to move, like EvaluateBoard.
+// With AVX2 eight positions are evaluated side by side: one gather fetches the same rank of all eight, and for every
+// square of it one more gather fetches the table entries of the eight pieces found there.
+void Chess::EvaluateBatch(const PackedPosition *positions, const size_t &count, float *evaluations) noexcept {
+    size_t first = 0;
+#ifdef __AVX2__
+    static_assert(sizeof(PackedPosition) % sizeof(int) == 0, "packed positions are gathered as 32-bit words");
+    constexpr int stride = sizeof(PackedPosition) / sizeof(int);
+    const __m256i &lanes = _mm256_setr_epi32(0, stride, 2*stride, 3*stride, 4*stride, 5*stride, 6*stride, 7*stride);
+    const __m256i &nibble = _mm256_set1_epi32(0xF);
+    for(;first+8<=count;first+=8) {
+        const int *words = reinterpret_cast<const int*>(positions + first);
+        __m256 sum = _mm256_setzero_ps();
+        for(short y=0;y<BOARD_SIZE;++y) {
+            const __m256i &ranks = _mm256_i32gather_epi32(words + y, lanes, sizeof(int));
+            for(short x=0;x<BOARD_SIZE;++x) {
+                const __m256i &pieces = _mm256_and_si256(_mm256_srli_epi32(ranks, 4*x), nibble);
+                const __m256i &index = _mm256_add_epi32(_mm256_slli_epi32(pieces, 6), _mm256_set1_epi32(y*BOARD_SIZE + x));
+                sum = _mm256_add_ps(sum, _mm256_i32gather_ps(EVALUATION_TABLE[0].data(), index, sizeof(float)));
+            }
+        }
+        const __m256 &sides = _mm256_setr_ps(positions[first].whites_turn ? 1 : -1, positions[first+1].whites_turn ? 1 : -1,
+                                             positions[first+2].whites_turn ? 1 : -1, positions[first+3].whites_turn ? 1 : -1,
+                                             positions[first+4].whites_turn ? 1 : -1, positions[first+5].whites_turn ? 1 : -1,
+                                             positions[first+6].whites_turn ? 1 : -1, positions[first+7].whites_turn ? 1 : -1);
+        _mm256_storeu_ps(evaluations + first, _mm256_mul_ps(sum, sides));
+    }
+#endif
+    for(;first<count;++first) {
+        float total_evaluation = 0.0;
+        for(short y=0;y<BOARD_SIZE;++y)
+            for(short x=0;x<BOARD_SIZE;++x)
+                total_evaluation += EVALUATION_TABLE[(positions[first].ranks[y] >> 4*x) & 0xF][y*BOARD_SIZE + x];
+        evaluations[first] = positions[first].whites_turn ? total_evaluation : -total_evaluation;
+    }
+}
+
+// splits the positions into batches of EVALUATION_BATCH_SIZE that the given number of threads take one after the other
+void Chess::EvaluatePositions(const PackedPosition *positions, const size_t &count, float *evaluations, const unsigned short &threads) noexcept {
+    if(threads <= 1 || count <= EVALUATION_BATCH_SIZE) {
+        EvaluateBatch(positions, count, evaluations);
+        return;
+    }
+    std::atomic<size_t> next_batch(0);
+    std::vector<std::thread> workers;
+    for(unsigned short i=0;i<threads;++i)
+        workers.emplace_back([&positions, &count, &evaluations, &next_batch]() {
+            for(size_t first; (first = EVALUATION_BATCH_SIZE * next_batch++) < count;)
+                EvaluateBatch(positions + first, std::min<size_t>(EVALUATION_BATCH_SIZE, count - first), evaluations + first);
+        });
+    for(auto &worker : workers)
+        worker.join();
 }
 
 void Chess::PrintBoard() const noexcept {
@@ -957,8 +2666,8 @@ void Chess::PrintBoard() const noexcept {
         PrintSeparator(' ');
         std::cout << "\b\b\b" << BOARD_SIZE-y << "  ";
         for(short x=0;x<BOARD_SIZE;++x) {
-            const unsigned short &diff = BOX_WIDTH - PieceNameToString(board[y][x]).length();
-            std::cout << std::string(diff/2, ' ') << PieceNameToString(board[y][x]) << std::string(diff/2, ' ');
+            const unsigned short &diff = BOX_WIDTH - PieceNameToString(board[Mailbox(x, y)]).length();
+            std::cout << std::string(diff/2, ' ') << PieceNameToString(board[Mailbox(x, y)]) << std::string(diff/2, ' ');
             if(diff%2)                std::cout << " ";
             if(x < BOARD_SIZE-1)    std::cout << "|";
         }
@@ -1006,7 +2715,9 @@ void Chess::PrintAllMovesMadeInOrder() const noexcept {
 }
 
 bool Chess::CheckEndgame(const unsigned short &n) noexcept {
-    if(AllMoves().empty()) {
+    if(!HasLegalMove()) {
+        if(!IsCheck())
+            return EndGameText(n, STALEMATE);
         GetOtherPlayer().IncreaseScore(EvaluatePiece(W_KING));
         UpdateScore(GetOtherPlayerConst());
         return EndGameText(n, CHECKMATE);
@@ -1021,7 +2732,9 @@ bool Chess::CheckEndgame(const unsigned short &n) noexcept {
     }
     else if((++moves_after_last_pawn_move_or_capture) == 50)
         return EndGameText(n, FIFTY_MOVES);
-    if(ThreefoldRepetition())
+    if(IsInsufficientMaterial())
+        return EndGameText(n, INSUFFICIENT_MATERIAL);
+    if(RepetitionCount() >= 2)
         return EndGameText(n, THREEFOLD_REP);
     return false;
 }
@@ -1099,8 +2812,1561 @@ bool Chess::GameOver() noexcept {
     }
 }
 
+// --- SessionManager Implementation ---
+// the store file is created empty, and removed again with the manager
+SessionManager::SessionManager(const size_t &max_sessions, const std::string &store_path) noexcept : sessions(max_sessions), store_path(store_path) {
+    for(size_t slot=max_sessions;slot-- > 0;)
+        free_slots.push_back(slot);
+    if(!store_path.empty())
+        store.open(store_path, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+}
+
+SessionManager::~SessionManager() noexcept {
+    if(store.is_open()) {
+        store.close();
+        std::remove(store_path.c_str());
+    }
+}
+
+// reserves a session for the calling thread, reading it back from the store if it is suspended
+SessionStatus SessionManager::Acquire(const SessionId &id, size_t &slot) noexcept {
+    std::lock_guard<std::mutex> lock(mutex);
+    const auto &found = resident.find(id);
+    if(found != resident.end()) {
+        slot = found->second;
+        return sessions[slot].busy.exchange(true) ? SESSION_BUSY : SESSION_OK;
+    }
+    const auto &suspension = suspended.find(id);
+    if(suspension == suspended.end())
+        return SESSION_UNKNOWN;
+    const long long offset = suspension->second;        // making room may suspend another session and move this entry
+    if(!FreeSlot(slot))
+        return SESSION_FULL;
+    Session &session = sessions[slot];
+    if(!ReadRecord(store, offset, id, session.game)) {
+        free_slots.push_back(slot);
+        return SESSION_STORE_FAILED;
+    }
+    suspended.erase(id);
+    ++dead_records, ++store_stats.resumes;
+    session.id = id;
+    session.busy = true;
+    resident[id] = slot;
+    CompactStore();
+    return SESSION_OK;
+}
+
+void SessionManager::Release(const size_t &slot) noexcept {
+    sessions[slot].last_used = std::chrono::steady_clock::now();
+    sessions[slot].busy = false;
+}
+
+// Takes a free slot, making one by suspending the session that has been idle the longest if there is none. Only
+// Release changes the busy flag without the mutex, so a session seen idle here stays idle.
+bool SessionManager::FreeSlot(size_t &slot) noexcept {
+    if(free_slots.empty()) {
+        size_t oldest = sessions.size();
+        for(size_t i=0;i<sessions.size();++i)
+            if(!sessions[i].busy && (oldest == sessions.size() || sessions[i].last_used < sessions[oldest].last_used))
+                oldest = i;
+        if(oldest == sessions.size() || !Suspend(oldest))
+            return false;
+    }
+    slot = free_slots.back();
+    free_slots.pop_back();
+    return true;
+}
+
+// appends the record of an idle session to the store and frees its slot
+bool SessionManager::Suspend(const size_t &slot) noexcept {
+    if(!store.is_open())
+        return false;
+    const Session &session = sessions[slot];
+    const long long &offset = WriteRecord(store, session.id, session.game);
+    if(offset < 0)
+        return false;
+    suspended[session.id] = offset;
+    resident.erase(session.id);
+    free_slots.push_back(slot);
+    ++store_stats.suspends;
+    store_stats.bytes = store.tellp();
+    return true;
+}
+
+// reads the record of the given session at the given offset; false if it is not there
+bool SessionManager::ReadRecord(std::fstream &file, const long long &offset, const SessionId &id, GameRecord &game) noexcept {
+    SessionId stored_id = 0;
+    file.clear();
+    file.seekg(offset);
+    file.read(reinterpret_cast<char*>(&stored_id), sizeof(stored_id));
+    file.read(reinterpret_cast<char*>(&game), offsetof(GameRecord, moves));
+    if(!file || stored_id != id || game.move_count > SESSION_MOVES)
+        return false;
+    file.read(reinterpret_cast<char*>(game.moves), game.move_count * sizeof(PackedMove));
+    return static_cast<bool>(file);
+}
+
+// appends a record, the session id followed by the game without its unused moves; returns its offset, or -1 on failure
+long long SessionManager::WriteRecord(std::fstream &file, const SessionId &id, const GameRecord &game) noexcept {
+    file.clear();
+    file.seekp(0, std::ios::end);
+    const long long offset = file.tellp();
+    file.write(reinterpret_cast<const char*>(&id), sizeof(id));
+    file.write(reinterpret_cast<const char*>(&game), offsetof(GameRecord, moves) + game.move_count * sizeof(PackedMove));
+    file.flush();
+    return file ? offset : -1;
+}
+
+// Rewrites the store with only the records of suspended sessions once most of its records are dead. The new file
+// replaces the old one only when it is complete, so a failure leaves the store as it was.
+void SessionManager::CompactStore() noexcept {
+    if(dead_records < STORE_COMPACT_RECORDS || dead_records < suspended.size())
+        return;
+    const std::string &temporary_path = store_path + ".tmp";
+    std::fstream compacted(temporary_path, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+    std::unordered_map<SessionId, long long> offsets;
+    GameRecord game;
+    bool written = compacted.is_open();
+    for(auto entry=suspended.cbegin();written && entry!=suspended.cend();++entry) {
+        const long long &offset = ReadRecord(store, entry->second, entry->first, game) ? WriteRecord(compacted, entry->first, game) : -1;
+        written = offset >= 0;
+        offsets[entry->first] = offset;
+    }
+    const long long &bytes = written ? static_cast<long long>(compacted.tellp()) : 0;
+    compacted.close();
+    store.close();
+    if(!written || std::rename(temporary_path.c_str(), store_path.c_str())) {
+        std::remove(temporary_path.c_str());
+        store.open(store_path, std::ios::in | std::ios::out | std::ios::binary);
+        return;
+    }
+    store.open(store_path, std::ios::in | std::ios::out | std::ios::binary);
+    suspended.swap(offsets);
+    dead_records = 0;
+    ++store_stats.compactions;
+    store_stats.bytes = bytes;
+}
+
+// sets the game up on the given Chess object: the base position, then the moves since
+void SessionManager::Hydrate(const GameRecord &game, Chess &c) noexcept {
+    c.SetPosition(game.base);
+    for(unsigned char i=0;i<game.move_count;++i) {
+        const short &from = game.moves[i] & 0x3F, &to = game.moves[i] >> 6;
+        c.MovePiece(from % BOARD_SIZE, from / BOARD_SIZE, to % BOARD_SIZE, to / BOARD_SIZE, false, false);
+    }
+}
+
+// Stores the move just played on the hydrated game, which starts a new base position if the move was irreversible,
+// and finds out whether it ended the game.
+void SessionManager::Record(GameRecord &game, Chess &c, const std::string &move) noexcept {
+    if(c.LastMoveWasIrreversible()) {
+        game.base = c.GetCompactPosition();
+        game.move_count = 0;
+    }
+    else
+        game.moves[game.move_count++] = (move[1]*BOARD_SIZE + move[0]) | (move[3]*BOARD_SIZE + move[2]) << 6;
+    game.turn_start = std::chrono::steady_clock::now();
+    game.over = true;
+    if(!c.HasLegalMove())
+        game.result = c.IsCheck() ? CHECKMATE : STALEMATE;
+    else if(c.IsInsufficientMaterial())
+        game.result = INSUFFICIENT_MATERIAL;
+    else if(game.move_count == SESSION_MOVES)
+        game.result = FIFTY_MOVES;
+    else if(c.RepetitionCount() >= 2)
+        game.result = THREEFOLD_REP;
+    else
+        game.over = false;
+}
+
+// takes the time since the turn began from the side to move and gives it its increment; returns false if the time ran out
+bool SessionManager::ChargeClock(GameRecord &game, const bool &white) noexcept {
+    if(!game.clock.white_time && !game.clock.black_time)
+        return true;
+    long long &time = white ? game.clock.white_time : game.clock.black_time;
+    time -= std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - game.turn_start).count();
+    if(time <= 0) {
+        time = 0;
+        game.over = true;
+        game.result = TIME_FORFEIT;
+        return false;
+    }
+    time += white ? game.clock.white_increment : game.clock.black_increment;
+    return true;
+}
+
+size_t SessionManager::GetOpenSessions() noexcept {
+    std::lock_guard<std::mutex> lock(mutex);
+    return resident.size() + suspended.size();
+}
+
+size_t SessionManager::GetSuspendedSessions() noexcept {
+    std::lock_guard<std::mutex> lock(mutex);
+    return suspended.size();
+}
+
+StoreStats SessionManager::GetStoreStats() noexcept {
+    std::lock_guard<std::mutex> lock(mutex);
+    return store_stats;
+}
+
+// starts a game from the starting position; the bot plays the given color and, without a clock, searches to the given depth
+SessionStatus SessionManager::Open(const Color &bot_color, const unsigned short &difficulty, const GameClock &clock, SessionId &id) noexcept {
+    static const CompactPosition start = Chess("", 0, "", 0).GetCompactPosition();
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t slot;
+    if(!FreeSlot(slot))
+        return SESSION_FULL;
+    id = next_id++;
+    Session &session = sessions[slot];
+    session.game.base = start;
+    session.game.move_count = 0;
+    session.game.clock = clock;
+    session.game.turn_start = session.last_used = std::chrono::steady_clock::now();
+    session.game.difficulty = difficulty;
+    session.game.bot_color = bot_color;
+    session.game.over = false;
+    session.id = id;
+    resident[id] = slot;
+    return SESSION_OK;
+}
+
+SessionStatus SessionManager::Close(const SessionId &id) noexcept {
+    std::lock_guard<std::mutex> lock(mutex);
+    const auto &found = resident.find(id);
+    if(found != resident.end()) {
+        if(sessions[found->second].busy)
+            return SESSION_BUSY;
+        free_slots.push_back(found->second);
+        resident.erase(found);
+        return SESSION_OK;
+    }
+    const auto &offset = suspended.find(id);
+    if(offset == suspended.end())
+        return SESSION_UNKNOWN;
+    suspended.erase(offset);
+    ++dead_records;
+    CompactStore();
+    return SESSION_OK;
+}
+
+// suspends every session no call has used for the given time, e.g. a correspondence game waiting for its human player
+size_t SessionManager::SuspendIdle(const double &idle_seconds) noexcept {
+    std::lock_guard<std::mutex> lock(mutex);
+    const auto &now = std::chrono::steady_clock::now();
+    std::vector<size_t> idle;
+    for(const auto &entry : resident)
+        if(!sessions[entry.second].busy && std::chrono::duration<double>(now - sessions[entry.second].last_used).count() >= idle_seconds)
+            idle.push_back(entry.second);
+    size_t count = 0;
+    for(const auto &slot : idle)
+        count += Suspend(slot);
+    return count;
+}
+
+// the legal moves of the side to move in coordinate notation, none once the game is over
+SessionStatus SessionManager::GetLegalMoves(const SessionId &id, std::forward_list<std::string> &moves) noexcept {
+    moves.clear();
+    size_t slot;
+    SessionStatus status = Acquire(id, slot);
+    if(status != SESSION_OK)
+        return status;
+    const GameRecord &game = sessions[slot].game;
+    if(game.over)
+        status = SESSION_OVER;
+    else {
+        Chess c("", 0, "", 0);
+        Hydrate(game, c);
+        moves = c.AllMoves();
+    }
+    Release(slot);
+    return status;
+}
+
+// SESSION_OVER with the reason once the game is over; after CHECKMATE and TIME_FORFEIT the side to move has lost
+SessionStatus SessionManager::GetResult(const SessionId &id, Endgame &result) noexcept {
+    size_t slot;
+    SessionStatus status = Acquire(id, slot);
+    if(status != SESSION_OK)
+        return status;
+    if(sessions[slot].game.over) {
+        status = SESSION_OVER;
+        result = sessions[slot].game.result;
+    }
+    Release(slot);
+    return status;
+}
+
+// plays the move of the human player, given in coordinate notation (e.g. "e2e4")
+SessionStatus SessionManager::PlayMove(const SessionId &id, const std::string &move) noexcept {
+    size_t slot;
+    SessionStatus status = Acquire(id, slot);
+    if(status != SESSION_OK)
+        return status;
+    GameRecord &game = sessions[slot].game;
+    const bool &white = game.base.position.whites_turn != (game.move_count % 2);
+    if(game.over)
+        status = SESSION_OVER;
+    else if(white == (game.bot_color == WHITE))
+        status = SESSION_NOT_YOUR_TURN;
+    else {
+        Chess c("", 0, "", 0);
+        Hydrate(game, c);
+        if(!c.PlayMove(move))
+            status = SESSION_ILLEGAL_MOVE;
+        else if(!ChargeClock(game, white))
+            status = SESSION_OVER;
+        else {
+            std::string real_move = move;
+            Chess::ChangeToRealCoordinates(real_move[0], real_move[1], real_move[2], real_move[3]);
+            Record(game, c, real_move);
+        }
+    }
+    Release(slot);
+    return status;
+}
+
+// Searches and plays the move of the bot, which comes back in coordinate notation. With a clock the search gets the
+// time the bot has left; it loses on time if the search overruns it.
+SessionStatus SessionManager::BotMove(const SessionId &id, std::string &move) noexcept {
+    move.clear();
+    size_t slot;
+    SessionStatus status = Acquire(id, slot);
+    if(status != SESSION_OK)
+        return status;
+    GameRecord &game = sessions[slot].game;
+    const bool &white = game.base.position.whites_turn != (game.move_count % 2);
+    if(game.over)
+        status = SESSION_OVER;
+    else if(white != (game.bot_color == WHITE))
+        status = SESSION_NOT_YOUR_TURN;
+    else {
+        Chess c("", 0, "", 0);
+        Hydrate(game, c);
+        Bot bot("Session", game.difficulty);
+        GameClock clock = game.clock;
+        if(clock.white_time || clock.black_time)
+            (white ? clock.white_time : clock.black_time) -= std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - game.turn_start).count();
+        const std::string &best_move = clock.white_time || clock.black_time ? bot.GetIdealMove(c, clock) : bot.GetIdealMove(c);
+        if(!ChargeClock(game, white))
+            status = SESSION_OVER;
+        else {
+            c.MovePiece(best_move[0], best_move[1], best_move[2], best_move[3], false, false);
+            Record(game, c, best_move);
+            move = Chess::ToCoordinateString(best_move);
+        }
+    }
+    Release(slot);
+    return status;
+}
+
+// --- AnalysisCache Implementation ---
+bool AnalysisCache::Probe(const HashKey &key, const unsigned short &depth, AnalysisResult &result) noexcept {
+    const auto &found = index.find(key);
+    if(found == index.end() || found->second->second.depth < depth)
+        return false;
+    entries.splice(entries.begin(), entries, found->second);
+    result = found->second->second;
+    return true;
+}
+
+// keeps the deeper result if the position is there already
+void AnalysisCache::Store(const HashKey &key, const AnalysisResult &result) noexcept {
+    if(!capacity)
+        return;
+    const auto &found = index.find(key);
+    if(found != index.end()) {
+        entries.splice(entries.begin(), entries, found->second);
+        if(result.depth >= found->second->second.depth)
+            found->second->second = result;
+        return;
+    }
+    if(entries.size() == capacity) {
+        index.erase(entries.back().first);
+        entries.pop_back();
+    }
+    entries.emplace_front(key, result);
+    index[key] = entries.begin();
+}
+
+// --- SearchServer Implementation ---
+SearchServer::SearchServer(const unsigned short &threads, const unsigned short &max_batch, const size_t &cache_entries, const LoadPolicy &policy) noexcept
+: cache(cache_entries), workers(std::max<unsigned short>(threads, 1)), max_batch(std::max<unsigned short>(max_batch, 1)), policy(policy),
+  level_change(std::chrono::steady_clock::now()) {
+    for(unsigned short i=0;i<workers.size();++i)
+        this->threads.emplace_back(&SearchServer::Work, this, i);
+}
+
+// answers the requests still waiting before the workers end
+SearchServer::~SearchServer() noexcept {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    work.notify_all();
+    for(auto &thread : threads)
+        thread.join();
+}
+
+// asks for the given depth less the degradation level, but at least one ply
+void SearchServer::Analyse(const Chess &c, const unsigned short &requested_depth, const AnalysisCallback &callback) noexcept {
+    const HashKey &key = c.GetSearchKey();
+    AnalysisResult result;
+    std::unique_lock<std::mutex> lock(mutex);
+    ++stats.requests;
+    AdjustLevel();
+    const unsigned short depth = std::max(requested_depth - stats.level, 1);
+    stats.degraded += depth < requested_depth;
+    if(cache.Probe(key, depth, result)) {
+        ++stats.cache_hits;
+        lock.unlock();
+        callback(result, FROM_CACHE);
+        return;
+    }
+    const auto &found = analyses.find(key);
+    if(found != analyses.end()) {
+        ++stats.coalesced;
+        Job &job = *found->second;
+        if(!job.running)
+            job.depth = std::max(job.depth, depth);
+        job.waiters.push_back({depth, std::chrono::steady_clock::now(), callback});
+        return;
+    }
+    ++stats.searches;
+    const std::shared_ptr<Job> job = std::make_shared<Job>(Job{c, key, BATCH, depth, {}, 0, false, {{depth, std::chrono::steady_clock::now(), callback}}});
+    analyses[key] = job;
+    batch.push_back(job);
+    lock.unlock();
+    work.notify_one();
+}
+
+// Searches the bot's move, deepening for as long as the given number of seconds allows, halved for every degradation
+// level. The deadline stays where the given time puts it.
+void SearchServer::Move(const Chess &c, const double &seconds, const AnalysisCallback &callback) noexcept {
+    const auto &now = std::chrono::steady_clock::now();
+    const auto &deadline = now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+    const std::shared_ptr<Job> job = std::make_shared<Job>(Job{c, 0, INTERACTIVE, MAX_SEARCH_DEPTH, deadline, seconds, false, {{MAX_SEARCH_DEPTH, now, callback}}});
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++stats.moves;
+        AdjustLevel();
+        stats.degraded += stats.level > 0;
+        job->move_time = std::ldexp(seconds, -stats.level);
+        moves.push_back(job);
+        std::push_heap(moves.begin(), moves.end(), LaterDeadline);
+        Preempt();
+    }
+    work.notify_one();
+}
+
+// stops a running analysis if more moves are waiting than there are workers that will be free to take them
+void SearchServer::Preempt() noexcept {
+    size_t freeing = idle_workers;
+    for(const auto &worker : workers)
+        freeing += worker.job && worker.job->priority == BATCH && worker.stop;
+    if(moves.size() <= freeing)
+        return;
+    for(auto &worker : workers)
+        if(worker.job && worker.job->priority == BATCH && !worker.stop) {
+            worker.stop = true;
+            return;
+        }
+}
+
+// Takes the move with the earliest deadline, or else the first analysis if fewer than max_batch are running. After an
+// analysis, requests that asked for more depth than it reached wait for a deeper search of the same position; one
+// that was stopped for a move goes back to the front of the queue.
+void SearchServer::Work(const unsigned short &index) noexcept {
+    Worker &worker = workers[index];
+    std::unique_lock<std::mutex> lock(mutex);
+    while(true) {
+        ++idle_workers;
+        work.wait(lock, [this]() { return stopping || !moves.empty() || (!batch.empty() && running_batch < max_batch); });
+        --idle_workers;
+        std::shared_ptr<Job> job;
+        if(!moves.empty()) {
+            std::pop_heap(moves.begin(), moves.end(), LaterDeadline);
+            job = moves.back();
+            moves.pop_back();
+        }
+        else if(!batch.empty() && running_batch < max_batch) {
+            job = batch.front();
+            batch.pop_front();
+            ++running_batch;
+        }
+        else
+            return;
+        job->running = true;
+        worker.job = job;
+        Started(*job);
+        const unsigned short depth = job->depth;
+        lock.unlock();
+        TimeManager time_manager;
+        time_manager.SetStopSignal(&worker.stop);
+        if(job->priority == INTERACTIVE)
+            time_manager.Start(std::min(job->move_time, std::chrono::duration<double>(job->deadline - std::chrono::steady_clock::now()).count()));
+        else
+            time_manager.Start();
+        const AnalysisResult result = Search(job->position, depth, time_manager);
+        lock.lock();
+        worker.job = nullptr;
+        if(job->priority == INTERACTIVE) {
+            stats.deadline_misses += std::chrono::steady_clock::now() > job->deadline;
+            lock.unlock();
+            job->waiters.front().callback(result, SEARCHED);
+            lock.lock();
+            continue;
+        }
+        --running_batch;
+        const bool preempted = worker.stop;
+        worker.stop = false;
+        stats.preemptions += preempted;
+        cache.Store(job->key, result);
+        std::vector<Waiter> answered, deeper;
+        const bool first_answered = job->waiters.front().depth <= result.depth;
+        for(auto &waiter : job->waiters)
+            (waiter.depth <= result.depth ? answered : deeper).push_back(std::move(waiter));
+        if(deeper.empty())
+            analyses.erase(job->key);
+        else {
+            job->running = false;
+            job->depth = 0;
+            for(const auto &waiter : deeper)
+                job->depth = std::max(job->depth, waiter.depth);
+            job->waiters = std::move(deeper);
+            if(preempted)
+                batch.push_front(job);
+            else {
+                ++stats.searches;
+                batch.push_back(job);
+            }
+        }
+        work.notify_one();
+        lock.unlock();
+        for(size_t i=0;i<answered.size();++i)
+            answered[i].callback(result, !i && first_answered ? SEARCHED : COALESCED);
+        lock.lock();
+    }
+}
+
+// folds the time the first request of a search has waited for it into the average and sees whether the level should change
+void SearchServer::Started(const Job &job) noexcept {
+    const double &latency = std::chrono::duration<double>(std::chrono::steady_clock::now() - job.waiters.front().arrival).count();
+    stats.latency += 0.1 * (latency - stats.latency);
+    AdjustLevel();
+}
+
+void SearchServer::AdjustLevel() noexcept {
+    const auto &now = std::chrono::steady_clock::now();
+    if(std::chrono::duration<double>(now - level_change).count() < policy.interval)
+        return;
+    const double &queue = static_cast<double>(moves.size() + batch.size()) / workers.size();
+    if(stats.level < policy.max_level && (queue > policy.queue_high || stats.latency > policy.latency_high))
+        ++stats.level;
+    else if(stats.level > 0 && queue < policy.queue_low && stats.latency < policy.latency_low)
+        --stats.level;
+    else
+        return;
+    level_change = now;
+}
+
+AnalysisResult SearchServer::Search(Chess &c, const unsigned short &depth, TimeManager &time_manager) noexcept {
+    PathNode root;
+    SearchThread thread(nullptr, 0, time_manager);
+    unsigned short difficulty = depth;
+    const std::string &move = root.AlphaBetaRoot(c, difficulty, thread);
+    const std::vector<RootMove> &root_moves = root.GetRootMoves();
+    if(root_moves.size() <= 1)
+        return {move.empty() ? "" : Chess::ToCoordinateString(move), 0, MAX_SEARCH_DEPTH};
+    return {Chess::ToCoordinateString(move), root_moves.front().score, root.GetCompletedDepth()};
+}
+
+ServerStats SearchServer::GetStats() noexcept {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+// --- Benchmark ---
+// positions reached from the starting position by the given moves
+const std::vector<std::string> BENCH_POSITIONS = {
+    "",
+    "e2e4 e7e5 g1f3 b8c6 f1c4 f8c5 c2c3 g8f6 d2d4 e5d4",
+    "d2d4 d7d5 c2c4 e7e6 b1c3 g8f6 c1g5 f8e7 e2e3 e8g8",
+    "e2e4 c7c5 g1f3 d7d6 d2d4 c5d4 f3d4 g8f6 b1c3 a7a6"
+};
+
+// how often each benchmark position is evaluated when timing the evaluation functions
+const unsigned long BENCH_EVALUATIONS = 1000000;
+// how often the attackers of every square are looked up in each benchmark position
+const unsigned long BENCH_ATTACK_ROUNDS = 20000;
+
+// sets up a fresh game and plays the given space-separated moves; returns false at the first illegal one
+bool SetUpPosition(Chess &c, const std::string &moves) noexcept {
+    for(size_t begin = 0, end; begin < moves.length(); begin = end + 1) {
+        end = moves.find(' ', begin);
+        if(end == std::string::npos)
+            end = moves.length();
+        if(end > begin && !c.PlayMove(moves.substr(begin, end - begin)))
+            return false;
+    }
+    return true;
+}
+
+// packs the positions of the legal move tree below the current one, down to the given depth
+void CollectPositions(Chess &c, const unsigned short &depth, std::vector<PackedPosition> &positions) noexcept {
+    positions.push_back(c.Pack());
+    if(!depth)
+        return;
+    for(auto move : c.AllMoves()) {
+        Chess::ChangeToRealCoordinates(move[0], move[1], move[2], move[3]);
+        const BoardState state = c.GetState();
+        c.MovePiece(move[0], move[1], move[2], move[3], false, false);
+        CollectPositions(c, depth-1, positions);
+        c.MovePieceBack(state);
+    }
+}
+
+// reports perft and search speed over the bench positions, so that build options such as COPY_MAKE can be compared
+void RunBenchmark(const unsigned short &perft_depth, unsigned short search_depth) noexcept {
+    std::cout << "Benchmark (" << MAKE_UNMAKE_MODE << ", " << ATTACK_MODE << "), perft depth " << perft_depth << ", search depth " << search_depth << std::endl;
+    unsigned long long total_perft_nodes = 0, total_search_nodes = 0;
+    double total_perft_time = 0, total_search_time = 0, incremental_time = 0, all_squares_time = 0, attack_scan_time = 0, attack_table_time = 0;
+    volatile unsigned long attack_sink = 0;
+    volatile bool turn = true;        // keeps the compiler from evaluating the same position only once
+    volatile float evaluation_sink = 0;
+    std::vector<PackedPosition> positions;
+    for(unsigned short i=0;i<BENCH_POSITIONS.size();++i) {
+        Chess c("Bench1", search_depth, "Bench2", search_depth);
+        SetUpPosition(c, BENCH_POSITIONS[i]);
+        auto start = std::chrono::steady_clock::now();
+        const unsigned long long &perft_nodes = c.Perft(perft_depth);
+        const double &perft_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        Bot bot("Bench", search_depth);
+        start = std::chrono::steady_clock::now();
+        const std::string &move = bot.GetIdealMove(c, search_depth);
+        const double &search_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Position " << i+1 << ": perft " << perft_nodes << " nodes in " << perft_time << " s, search " << c.GetNodes() << " nodes in " << search_time << " s, best move " << Chess::ToCoordinateString(move) << std::endl;
+        total_perft_nodes += perft_nodes, total_perft_time += perft_time;
+        total_search_nodes += c.GetNodes(), total_search_time += search_time;
+        float evaluation_sum = 0;
+        start = std::chrono::steady_clock::now();
+        for(unsigned long j=0;j<BENCH_EVALUATIONS;++j)
+            evaluation_sum += c.EvaluateBoard(static_cast<bool>(turn));
+        incremental_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        start = std::chrono::steady_clock::now();
+        for(unsigned long j=0;j<BENCH_EVALUATIONS;++j)
+            evaluation_sum -= c.EvaluateAllSquares(static_cast<bool>(turn));
+        all_squares_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        evaluation_sink = evaluation_sink + evaluation_sum;
+        CollectPositions(c, 2, positions);
+        unsigned long attack_sum = 0;
+        start = std::chrono::steady_clock::now();
+        for(unsigned long j=0;j<BENCH_ATTACK_ROUNDS;++j) {
+            const Bitboard &occupied = c.Occupancy();
+            for(short sq=0;sq<BOARD_SIZE*BOARD_SIZE;++sq) {
+                char white_attacker, black_attacker;
+                attack_sum += c.ScanAttackers<WHITE>(sq, occupied, white_attacker) + c.ScanAttackers<BLACK>(sq, occupied, black_attacker) + white_attacker - black_attacker;
+            }
+        }
+        attack_scan_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+#ifdef ATTACK_TABLES
+        start = std::chrono::steady_clock::now();
+        for(unsigned long j=0;j<BENCH_ATTACK_ROUNDS;++j)
+            for(short sq=0;sq<BOARD_SIZE*BOARD_SIZE;++sq)
+                attack_sum -= c.AttackCount<WHITE>(sq) + c.AttackCount<BLACK>(sq) + c.LeastValuableAttacker<WHITE>(sq) - c.LeastValuableAttacker<BLACK>(sq);
+        attack_table_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+#endif
+        attack_sink = attack_sink + attack_sum;
+    }
+    std::cout << "Perft:  " << total_perft_nodes << " nodes, " << static_cast<unsigned long long>(total_perft_nodes / total_perft_time) << " nodes/s" << std::endl;
+    std::cout << "Search: " << total_search_nodes << " nodes, " << static_cast<unsigned long long>(total_search_nodes / total_search_time) << " nodes/s" << std::endl;
+    const double &evaluations = static_cast<double>(BENCH_EVALUATIONS) * BENCH_POSITIONS.size();
+    std::cout << "Eval:   incremental " << static_cast<unsigned long long>(evaluations / incremental_time) << " evals/s, all squares ("
+              << EVALUATION_KERNEL << ") " << static_cast<unsigned long long>(evaluations / all_squares_time) << " evals/s" << std::endl;
+    const double &attack_queries = 2.0 * BENCH_ATTACK_ROUNDS * BOARD_SIZE*BOARD_SIZE * BENCH_POSITIONS.size();
+    std::cout << "Attack: scans " << static_cast<unsigned long long>(attack_queries / attack_scan_time) << " squares/s";
+    if(attack_table_time > 0)
+        std::cout << ", tables " << static_cast<unsigned long long>(attack_queries / attack_table_time) << " squares/s";
+    std::cout << std::endl;
+    std::vector<float> batch_evaluations(positions.size());
+    const unsigned short threads = std::max(std::thread::hardware_concurrency(), 1U);
+    const size_t rounds = std::max<size_t>(evaluations / positions.size(), 1);
+    const auto &start = std::chrono::steady_clock::now();
+    for(size_t i=0;i<rounds;++i)
+        Chess::EvaluatePositions(positions.data(), positions.size(), batch_evaluations.data(), threads);
+    const double &batch_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Batch:  " << positions.size() << " packed positions, " << static_cast<unsigned long long>(rounds * positions.size() / batch_time)
+              << " evals/s (" << EVALUATION_KERNEL << ", " << threads << " threads)" << std::endl;
+}
+
+// --- Timed Search ---
+// searches the position after the given moves with the given clock, like an engine answering a UCI "go" command
+void RunTimedSearch(const GameClock &clock, const std::string &moves, const unsigned short &threads, const ParallelMode &mode) noexcept {
+    Chess c("Clock1", 1, "Clock2", 1);
+    if(!SetUpPosition(c, moves)) {
+        std::cout << "Illegal move in \"" << moves << "\"" << std::endl;
+        return;
+    }
+    Bot bot("Clock", MAX_SEARCH_DEPTH);
+    bot.SetThreads(threads, mode);
+    const std::string &move = bot.GetIdealMove(c, clock);
+    const TimeManager &time_manager = bot.GetTimeManager();
+    std::cout << "bestmove " << (move.empty() ? "(none)" : Chess::ToCoordinateString(move)) << std::endl;
+    std::cout << "Depth " << bot.GetSearch().GetCompletedDepth() << ", " << (bot.GetParallelSearch() ? bot.GetParallelSearch()->GetNodes() : c.GetNodes()) << " nodes in " << time_manager.Elapsed()
+              << " s (soft limit " << time_manager.GetSoftLimit() << " s, hard limit " << time_manager.GetHardLimit() << " s)" << std::endl;
+}
+
+// --- SMP Benchmark ---
+// how often each bench position is searched per thread count, to see how much the timings vary
+const unsigned short SMP_BENCH_RUNS = 3;
+
+// Searches every bench position to a fixed depth with 1, 2, 4, ... threads up to the given number, with a fresh table
+// every time. Speedups are relative to one thread running the same parallel search, so the table is used there too.
+// Node overhead is the extra work the threads do compared to one thread reaching the same depth.
+void RunSmpBenchmark(const unsigned short &max_threads, const unsigned short &depth, const unsigned short &runs, const ParallelMode &mode) noexcept {
+    std::cout << "SMP benchmark (" << (mode == LAZY_SMP ? "lazy SMP" : "young brothers wait") << "), depth " << depth << ", " << runs
+              << " runs over " << BENCH_POSITIONS.size() << " positions, " << std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+    std::vector<unsigned short> thread_counts;
+    for(unsigned short threads=1;threads<max_threads;threads*=2)
+        thread_counts.push_back(threads);
+    thread_counts.push_back(std::max<unsigned short>(max_threads, 1));
+    double base_time = 0, base_speed = 0;
+    unsigned long long base_nodes = 0;
+    for(const auto &threads : thread_counts) {
+        std::vector<double> times;
+        unsigned long long nodes = 0;
+        TableStats stats = {};
+        for(unsigned short run=0;run<runs;++run) {
+            double time = 0;
+            for(const auto &moves : BENCH_POSITIONS) {
+                Chess c("Smp1", depth, "Smp2", depth);
+                SetUpPosition(c, moves);
+                ParallelSearch search(threads, mode, SEARCH_HASH_MB);
+                PathNode root;
+                TimeManager time_manager;
+                unsigned short difficulty = depth;
+                const auto &start = std::chrono::steady_clock::now();
+                time_manager.Start();
+                search.Search(c, root, difficulty, time_manager);
+                time += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                nodes += search.GetNodes();
+                const TableStats &search_stats = search.GetTableStats();
+                stats.probes += search_stats.probes, stats.hits += search_stats.hits, stats.shared_hits += search_stats.shared_hits;
+                stats.stores += search_stats.stores, stats.replacements += search_stats.replacements;
+            }
+            times.push_back(time);
+        }
+        double mean = 0, variance = 0;
+        for(const auto &time : times)
+            mean += time / times.size();
+        for(const auto &time : times)
+            variance += (time - mean) * (time - mean) / std::max<size_t>(times.size() - 1, 1);
+        const double &speed = nodes / (mean * runs);
+        if(threads == thread_counts.front())
+            base_time = mean, base_speed = speed, base_nodes = nodes;
+        std::cout << "Threads " << threads << ": time to depth " << mean << " s +- " << std::sqrt(variance) << " (speedup " << base_time / mean
+                  << "), " << static_cast<unsigned long long>(speed) << " nodes/s (speedup " << speed / base_speed << "), node overhead "
+                  << 100.0 * nodes / base_nodes - 100 << "%, table " << 100.0 * stats.hits / std::max(stats.probes, 1ULL) << "% hits, "
+                  << 100.0 * stats.shared_hits / std::max(stats.hits, 1ULL) << "% of them from other threads, "
+                  << 100.0 * stats.replacements / std::max(stats.stores, 1ULL) << "% of stores replace another thread's entry" << std::endl;
+    }
+}
+
+// --- Session Benchmark ---
+// Opens the given number of sessions, all live at once, and plays up to the given number of plies in each: a random
+// human move, then the bot's answer at the given depth. The sessions are shared out over the given number of threads.
+// With fewer slots than sessions, the sessions that do not fit are suspended to a store file at the given path.
+void RunSessionBenchmark(const size_t &count, const unsigned short &plies, const unsigned short &difficulty, const unsigned short &threads, const size_t &slots, const std::string &store_path) noexcept {
+    SessionManager manager(slots, slots < count ? store_path : "");
+    std::vector<SessionId> ids(count);
+    for(auto &id : ids)
+        manager.Open(BLACK, difficulty, {0, 0, 0, 0, 0}, id);
+    std::cout << "Sessions: " << manager.GetOpenSessions() << " open (" << manager.GetSuspendedSessions() << " suspended), " << slots << " slots of "
+              << SessionManager::GetSessionSize() << " bytes (" << slots * SessionManager::GetSessionSize() / 1024 << " KB in all), " << plies
+              << " plies at depth " << difficulty << " on " << threads << " threads" << std::endl;
+    std::atomic<unsigned long long> moves(0);
+    const auto &start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for(unsigned short index=0;index<threads;++index)
+        workers.emplace_back([&, index]() {
+            for(unsigned short ply=0;ply<plies;ply+=2)
+                for(size_t i=index;i<count;i+=threads) {
+                    std::forward_list<std::string> legal_moves;
+                    if(manager.GetLegalMoves(ids[i], legal_moves) != SESSION_OK)
+                        continue;
+                    auto move = legal_moves.begin();
+                    advance(move, GetRandomNumber<long>(0, distance(legal_moves.cbegin(), legal_moves.cend()) - 1));
+                    std::string reply;
+                    moves += manager.PlayMove(ids[i], *move) == SESSION_OK;
+                    moves += ply + 1 < plies && manager.BotMove(ids[i], reply) == SESSION_OK;
+                }
+        });
+    for(auto &worker : workers)
+        worker.join();
+    const double &time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const StoreStats &stats = manager.GetStoreStats();
+    size_t finished = 0;
+    for(const auto &id : ids) {
+        Endgame result;
+        finished += manager.GetResult(id, result) == SESSION_OVER;
+        manager.Close(id);
+    }
+    std::cout << moves << " moves in " << time << " s (" << static_cast<unsigned long long>(moves / time) << " moves/s), " << finished
+              << " games finished" << std::endl;
+    if(slots < count)
+        std::cout << "Store: " << stats.suspends << " suspends, " << stats.resumes << " resumes, " << stats.compactions << " compactions, "
+                  << stats.bytes / 1024 << " KB on disk" << std::endl;
+}
+
+// --- Search Server ---
+// Reads an analyse or move request of the protocol below. On failure, 'error' says why, and request.id holds the id
+// if the line got as far as it.
+bool ParseServerRequest(const std::string &line, ServerRequest &request, std::string &error) noexcept {
+    std::istringstream words(line);
+    std::string command, word, fen, moves;
+    words >> command;
+    if(command != "analyse" && command != "move") {
+        error = "unknown command " + command;
+        return false;
+    }
+    request.move = command == "move";
+    request.depth = 0, request.milliseconds = 0;
+    words >> request.id;
+    if(request.move)
+        words >> request.milliseconds;
+    else
+        words >> request.depth;
+    for(bool after_moves = false;words >> word;)
+        if(after_moves)
+            moves += (moves.empty() ? "" : " ") + word;
+        else if(word == "moves")
+            after_moves = true;
+        else
+            fen += (fen.empty() ? "" : " ") + word;
+    if(request.id.empty() || (!request.move && (!request.depth || request.depth > MAX_SEARCH_DEPTH)))
+        error = "depth must be 1 to " + std::to_string(MAX_SEARCH_DEPTH);
+    else if(request.move && request.milliseconds <= 0)
+        error = "the time must be positive";
+    else if((fen != "startpos" && !request.position.SetPosition(fen)) || !SetUpPosition(request.position, moves))
+        error = "illegal position or move";
+    else
+        return true;
+    return false;
+}
+
+// Serves requests read from standard input, one per line, and writes every answer to standard output as soon as it is
+// known, which need not be in the order of the requests:
+//   analyse <id> <depth> startpos|<fen> [moves <move> ...]  ->  result <id> <move>|(none) score <score> depth <depth> cached|coalesced|searched
+//   move <id> <milliseconds> startpos|<fen> [moves <move> ...] ->  result <id> <move>|(none) score <score> depth <depth> searched [late]
+//   stats                                                   ->  stats requests <n> cache_hits <n> coalesced <n> searches <n> moves <n> ...
+// A move is a bot move due within the given time, which goes before every analysis; "late" marks one that missed it.
+// Malformed requests are answered with "error <id> <reason>". "quit" or the end of the input waits for the requests
+// still running and returns.
+void RunServer(const unsigned short &threads, const unsigned short &max_batch, const size_t &cache_entries, const LoadPolicy &policy) noexcept {
+    std::mutex output;
+    SearchServer server(threads, max_batch, cache_entries, policy);
+    const auto &print = [&output](const std::string &line) {
+        std::lock_guard<std::mutex> lock(output);
+        std::cout << line << std::endl;
+    };
+    std::string line;
+    while(std::getline(std::cin, line)) {
+        std::istringstream words(line);
+        std::string command;
+        words >> command;
+        if(command.empty())
+            continue;
+        if(command == "quit")
+            break;
+        if(command == "stats") {
+            const ServerStats &stats = server.GetStats();
+            print("stats requests " + std::to_string(stats.requests) + " cache_hits " + std::to_string(stats.cache_hits) + " coalesced "
+                  + std::to_string(stats.coalesced) + " searches " + std::to_string(stats.searches) + " moves " + std::to_string(stats.moves)
+                  + " deadline_misses " + std::to_string(stats.deadline_misses) + " preemptions " + std::to_string(stats.preemptions) + " level "
+                  + std::to_string(stats.level) + " latency_ms " + std::to_string(static_cast<long>(1000 * stats.latency)) + " degraded " + std::to_string(stats.degraded));
+            continue;
+        }
+        ServerRequest request;
+        std::string error;
+        if(!ParseServerRequest(line, request, error))
+            print("error " + (request.id.empty() ? "-" : request.id) + " " + error);
+        else if(request.move) {
+            const auto &deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(request.milliseconds);
+            server.Move(request.position, request.milliseconds / 1000.0, [print, id = request.id, deadline](const AnalysisResult &result, const AnalysisSource &) {
+                print("result " + id + " " + (result.move.empty() ? "(none)" : result.move) + " score " + std::to_string(result.score) + " depth "
+                      + std::to_string(result.depth) + " searched" + (std::chrono::steady_clock::now() > deadline ? " late" : ""));
+            });
+        }
+        else
+            server.Analyse(request.position, request.depth, [print, id = request.id](const AnalysisResult &result, const AnalysisSource &source) {
+                print("result " + id + " " + (result.move.empty() ? "(none)" : result.move) + " score " + std::to_string(result.score) + " depth "
+                      + std::to_string(result.depth) + (source == FROM_CACHE ? " cached" : source == COALESCED ? " coalesced" : " searched"));
+            });
+    }
+}
+
+// --- Load Generator ---
+// Synthesizes server requests from random games: positions after up to 40 random plies, mostly analyses at the given
+// depth and every fourth a bot move with the given number of milliseconds. Short games make some positions repeat.
+std::vector<ServerRequest> SynthesizeRequests(const size_t &count, const unsigned short &depth, const long &milliseconds) noexcept {
+    std::vector<ServerRequest> requests(count);
+    for(size_t i=0;i<count;++i) {
+        ServerRequest &request = requests[i];
+        request.move = i % 4 == 3;
+        request.id = std::to_string(i);
+        request.depth = depth, request.milliseconds = milliseconds;
+        for(unsigned short ply=GetRandomNumber<unsigned short>(0, 40);ply>0;--ply) {
+            const auto &legal_moves = request.position.AllMoves();
+            if(legal_moves.empty())
+                break;
+            auto move = legal_moves.begin();
+            advance(move, GetRandomNumber<long>(0, distance(legal_moves.cbegin(), legal_moves.cend()) - 1));
+            request.position.PlayMove(*move);
+        }
+    }
+    return requests;
+}
+
+// what a load test step measured; latencies are in seconds
+typedef struct {
+    size_t requests, moves, late;
+    double throughput;                       // requests answered per second
+    double p50, p90, p99, max;
+    ServerStats server;
+} LoadResult;
+
+// Sends the requests to a new server, at the given rate per second (0 for all at once) but with at most 'concurrency'
+// unanswered. Latencies are counted from the time a request was due to be sent, so that a server falling behind the
+// rate is charged for the requests it holds up.
+LoadResult ReplayRequests(const std::vector<ServerRequest> &requests, const double &rate, const size_t &concurrency, const unsigned short &threads,
+                          const unsigned short &max_batch, const size_t &cache_entries, const LoadPolicy &policy) noexcept {
+    std::mutex mutex;
+    std::condition_variable answered;
+    size_t unanswered = 0;
+    std::vector<double> latencies(requests.size());
+    LoadResult result = {requests.size(), 0, 0, 0, 0, 0, 0, 0, {}};
+    SearchServer server(threads, max_batch, cache_entries, policy);
+    const auto &start = std::chrono::steady_clock::now();
+    for(size_t i=0;i<requests.size();++i) {
+        const auto &due = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(rate > 0 ? i / rate : 0));
+        std::this_thread::sleep_until(due);
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            answered.wait(lock, [&]() { return unanswered < std::max<size_t>(concurrency, 1); });
+            ++unanswered;
+        }
+        const ServerRequest &request = requests[i];
+        const auto &deadline = due + std::chrono::milliseconds(request.milliseconds);
+        const AnalysisCallback &callback = [&, i, due, deadline](const AnalysisResult &, const AnalysisSource &) {
+            const auto &now = std::chrono::steady_clock::now();
+            std::lock_guard<std::mutex> lock(mutex);
+            latencies[i] = std::chrono::duration<double>(now - due).count();
+            result.late += requests[i].move && now > deadline;
+            --unanswered;
+            answered.notify_all();
+        };
+        if(request.move)
+            ++result.moves, server.Move(request.position, request.milliseconds / 1000.0, callback);
+        else
+            server.Analyse(request.position, request.depth, callback);
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    answered.wait(lock, [&]() { return !unanswered; });
+    result.throughput = requests.size() / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.server = server.GetStats();
+    std::sort(latencies.begin(), latencies.end());
+    if(!latencies.empty()) {
+        const auto &percentile = [&latencies](const double &p) { return latencies[std::min<size_t>(p * latencies.size(), latencies.size() - 1)]; };
+        result.p50 = percentile(0.5), result.p90 = percentile(0.9), result.p99 = percentile(0.99), result.max = latencies.back();
+    }
+    return result;
+}
+
+// Replays the requests of a trace file, written in the protocol of RunServer() and replayed without their stats and
+// quit lines, or, with an empty path, the given number of synthesized ones. A positive rate is offered once. Otherwise rates from one per
+// second upwards are offered in turn, each doubling the last and lasting LOAD_STEP_SECONDS, until the server answers
+// less than LOAD_SATURATION of the rate or misses the deadline of more than one move in a hundred; the last rate it
+// kept up with is its saturation point.
+void RunLoadTest(const std::string &trace_path, const size_t &count, const double &rate, const size_t &concurrency, const unsigned short &threads,
+                 const unsigned short &max_batch, const size_t &cache_entries, const LoadPolicy &policy) noexcept {
+    std::vector<ServerRequest> requests;
+    if(trace_path.empty())
+        requests = SynthesizeRequests(count, LOAD_DEPTH, LOAD_MOVE_MILLISECONDS);
+    else {
+        std::ifstream trace(trace_path);
+        if(!trace) {
+            std::cerr << "Cannot read " << trace_path << std::endl;
+            return;
+        }
+        std::string line, command, error;
+        for(size_t number=1;std::getline(trace, line);++number) {
+            std::istringstream(line) >> command;
+            if(command.empty() || command == "stats" || command == "quit")
+                continue;
+            requests.emplace_back();
+            if(!ParseServerRequest(line, requests.back(), error)) {
+                std::cerr << trace_path << ":" << number << ": " << error << std::endl;
+                requests.pop_back();
+            }
+            command.clear();
+        }
+    }
+    if(requests.empty()) {
+        std::cerr << "No requests to send" << std::endl;
+        return;
+    }
+    std::cout << "Load test: " << requests.size() << " requests" << (trace_path.empty() ? " synthesized" : " from " + trace_path) << ", at most "
+              << concurrency << " unanswered, " << threads << " threads (" << max_batch << " for analyses)" << std::endl;
+    double sustained = 0;
+    for(double offered=(rate > 0 ? rate : 1);;offered*=2) {
+        std::vector<ServerRequest> step(requests);
+        if(rate <= 0)
+            step.resize(std::min<size_t>(std::max<size_t>(offered * LOAD_STEP_SECONDS, 1), requests.size()));
+        const LoadResult &result = ReplayRequests(step, offered, concurrency, threads, max_batch, cache_entries, policy);
+        std::cout << "Rate " << offered << "/s: " << result.requests << " requests, " << result.throughput << " answered/s, latency p50 "
+                  << 1000 * result.p50 << " ms, p90 " << 1000 * result.p90 << " ms, p99 " << 1000 * result.p99 << " ms, max " << 1000 * result.max
+                  << " ms, " << result.late << " of " << result.moves << " moves late, " << result.server.cache_hits << " cache hits, "
+                  << result.server.coalesced << " coalesced, " << result.server.degraded << " degraded, level " << result.server.level << std::endl;
+        if(rate > 0)
+            return;
+        if(result.throughput < LOAD_SATURATION * offered || 100 * result.late > result.moves) {
+            if(sustained)
+                std::cout << "Saturation: the server kept up with " << sustained << " requests/s but not with " << offered << std::endl;
+            else
+                std::cout << "Saturation: the server did not keep up with " << offered << " request/s" << std::endl;
+            return;
+        }
+        sustained = offered;
+        if(step.size() == requests.size()) {
+            std::cout << "Saturation: not reached, the server kept up with " << sustained << " requests/s; more requests are needed to go further" << std::endl;
+            return;
+        }
+    }
+}
+
+// --- Parallel Perft ---
+// Splits the root moves over the given number of threads. Each thread plays them on its own copy of the game, the
+// subtree sizes land in 'divide' and the table is shared between all threads.
+unsigned long long ParallelPerft(const Chess &c, const unsigned short &depth, const unsigned short &threads, PerftTable &table, std::vector<std::pair<std::string, unsigned long long>> &divide) noexcept {
+    divide.clear();
+    if(!depth)
+        return 1;
+    Chess root(c);
+    for(const auto &move : root.AllMoves())
+        divide.emplace_back(move, 0);
+    std::atomic<size_t> next_move(0);
+    std::vector<std::thread> workers;
+    for(unsigned short i=0;i<std::max<unsigned short>(threads, 1);++i)
+        workers.emplace_back([&c, &depth, &table, &divide, &next_move]() {
+            Chess game(c);
+            for(size_t index; (index = next_move++) < divide.size();) {
+                auto move = divide[index].first;
+                Chess::ChangeToRealCoordinates(move[0], move[1], move[2], move[3]);
+                const BoardState state = game.GetState();
+                game.MovePiece(move[0], move[1], move[2], move[3], false, false);
+                divide[index].second = game.Perft(depth-1, &table);
+                game.MovePieceBack(state);
+            }
+        });
+    for(auto &worker : workers)
+        worker.join();
+    unsigned long long leaf_nodes = 0;
+    for(const auto &root_move : divide)
+        leaf_nodes += root_move.second;
+    return leaf_nodes;
+}
+
+void RunPerft(const unsigned short &depth, const unsigned short &threads, const size_t &hash_megabytes, const std::string &moves) noexcept {
+    Chess c("Perft1", 1, "Perft2", 1);
+    if(!SetUpPosition(c, moves)) {
+        std::cerr << "Illegal move in \"" << moves << "\"" << std::endl;
+        return;
+    }
+    PerftTable table(hash_megabytes);
+    std::vector<std::pair<std::string, unsigned long long>> divide;
+    const auto &start = std::chrono::steady_clock::now();
+    const unsigned long long &leaf_nodes = ParallelPerft(c, depth, threads, table, divide);
+    const double &time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::sort(divide.begin(), divide.end());
+    for(const auto &root_move : divide)
+        std::cout << root_move.first << ": " << root_move.second << std::endl;
+    std::cout << "Perft " << depth << ": " << leaf_nodes << " nodes in " << time << " s (" << static_cast<unsigned long long>(leaf_nodes / time) << " nodes/s, " << threads << " threads)" << std::endl;
+}
+
+// --- Move Generator Fuzzer ---
+// Deliberately simple re-implementation of the rules as the original char-board generators play them, quirks included:
+// one castling flag per side, queenside castling shadowing kingside, castling only checked for the king's own square
+// and promotion to a queen. It copies the board for every move it tries and attacks are found by scanning every
+// piece, so it shares no code with the optimized generator it is used to cross-check.
+class ReferenceBoard {
+private:
+    char board[BOARD_SIZE][BOARD_SIZE];
+    bool whites_turn = true;
+    bool castling[2] = {true, true};
+    short double_step_file = -1;
+    static bool OnBoard(const short &x, const short &y) noexcept;
+    bool Attacks(const short &x1, const short &y1, const short &x2, const short &y2) const noexcept;
+    bool IsAttacked(const short &x, const short &y, const bool &by_white) const noexcept;
+    bool IsKingAttacked(const bool &white_king) const noexcept;
+    void AddIfPossible(const short &x1, const short &y1, const short &x2, const short &y2, std::vector<std::string> &moves) const noexcept;
+public:
+    ReferenceBoard() noexcept;
+    std::vector<std::string> LegalMoves() const noexcept;
+    void MakeMove(const std::string &move) noexcept;
+    bool SameBoard(const BoardState &state) const noexcept;
+    float Evaluate() const noexcept;
+    HashKey Key() const noexcept;
+};
+
+ReferenceBoard::ReferenceBoard() noexcept {
+    std::copy(*STARTING_BOARD, *STARTING_BOARD + BOARD_SIZE*BOARD_SIZE, *board);
+}
+
+bool ReferenceBoard::OnBoard(const short &x, const short &y) noexcept {
+    return x>=0 && x<BOARD_SIZE && y>=0 && y<BOARD_SIZE;
+}
+
+// whether the piece on (x1, y1) attacks the square (x2, y2)
+bool ReferenceBoard::Attacks(const short &x1, const short &y1, const short &x2, const short &y2) const noexcept {
+    const short &dx = x2-x1, &dy = y2-y1, &piece = board[y1][x1] < 0 ? board[y1][x1] + 7 : board[y1][x1];
+    switch(piece) {
+        case W_PAWN:    return abs(dx) == 1 && dy == (board[y1][x1] > 0 ? -1 : 1);
+        case W_KNIGHT:  return (abs(dx) == 1 && abs(dy) == 2) || (abs(dx) == 2 && abs(dy) == 1);
+        case W_KING:    return std::max(abs(dx), abs(dy)) == 1;
+        case W_ROOK:    if(dx && dy) return false;                      break;
+        case W_BISHOP:  if(abs(dx) != abs(dy)) return false;            break;
+        case W_QUEEN:   if(dx && dy && abs(dx) != abs(dy)) return false; break;
+        default:        return false;
+    }
+    if(!dx && !dy)
+        return false;
+    const short &sx = (dx > 0) - (dx < 0), &sy = (dy > 0) - (dy < 0);
+    for(short x=x1+sx, y=y1+sy; x!=x2 || y!=y2; x+=sx, y+=sy)
+        if(board[y][x] != EMPTY)
+            return false;
+    return true;
+}
+
+bool ReferenceBoard::IsAttacked(const short &x, const short &y, const bool &by_white) const noexcept {
+    for(short j=0;j<BOARD_SIZE;++j)
+        for(short i=0;i<BOARD_SIZE;++i)
+            if(board[j][i] != EMPTY && (board[j][i] > 0) == by_white && Attacks(i, j, x, y))
+                return true;
+    return false;
+}
+
+bool ReferenceBoard::IsKingAttacked(const bool &white_king) const noexcept {
+    for(short y=0;y<BOARD_SIZE;++y)
+        for(short x=0;x<BOARD_SIZE;++x)
+            if(board[y][x] == (white_king ? W_KING : B_KING))
+                return IsAttacked(x, y, !white_king);
+    return false;
+}
+
+// adds the move if it stays on the board, does not capture an own piece and does not leave the own king attacked
+void ReferenceBoard::AddIfPossible(const short &x1, const short &y1, const short &x2, const short &y2, std::vector<std::string> &moves) const noexcept {
+    if(!OnBoard(x2, y2) || (board[y2][x2] != EMPTY && (board[y2][x2] > 0) == whites_turn))
+        return;
+    const std::string &move = {static_cast<char>(x1+'a'), static_cast<char>('8'-y1), static_cast<char>(x2+'a'), static_cast<char>('8'-y2)};
+    ReferenceBoard next(*this);
+    next.MakeMove(move);
+    if(!next.IsKingAttacked(whites_turn))
+        moves.push_back(move);
+}
+
+std::vector<std::string> ReferenceBoard::LegalMoves() const noexcept {
+    std::vector<std::string> moves;
+    const short &forward = whites_turn ? -1 : 1;
+    for(short y=0;y<BOARD_SIZE;++y)
+        for(short x=0;x<BOARD_SIZE;++x) {
+            if(board[y][x] == EMPTY || (board[y][x] > 0) != whites_turn)
+                continue;
+            switch(board[y][x] < 0 ? board[y][x] + 7 : board[y][x]) {
+                case W_PAWN:
+                    if(board[y+forward][x] == EMPTY) {
+                        AddIfPossible(x, y, x, y+forward, moves);
+                        if(y == (whites_turn ? BOARD_SIZE-2 : 1) && board[y + 2*forward][x] == EMPTY)
+                            AddIfPossible(x, y, x, y + 2*forward, moves);
+                    }
+                    for(short dx=-1;dx<=1;dx+=2)
+                        if(OnBoard(x+dx, y+forward) && board[y+forward][x+dx] != EMPTY)
+                            AddIfPossible(x, y, x+dx, y+forward, moves);
+                    if(y == (whites_turn ? 3 : 4) && double_step_file != -1 && abs(double_step_file - x) == 1)
+                        AddIfPossible(x, y, double_step_file, y+forward, moves);
+                    break;
+                case W_KNIGHT:
+                    for(short dx=-2;dx<=2;++dx)
+                        for(short dy=-2;dy<=2;++dy)
+                            if(abs(dx) + abs(dy) == 3)
+                                AddIfPossible(x, y, x+dx, y+dy, moves);
+                    break;
+                case W_KING:
+                    for(short dx=-1;dx<=1;++dx)
+                        for(short dy=-1;dy<=1;++dy)
+                            if(dx || dy)
+                                AddIfPossible(x, y, x+dx, y+dy, moves);
+                    if(castling[whites_turn] && !IsAttacked(x, y, !whites_turn)) {
+                        const short &line = whites_turn ? BOARD_SIZE-1 : 0;
+                        const char &rook = whites_turn ? W_ROOK : B_ROOK;
+                        if(board[line][0] == rook && board[line][1] == EMPTY && board[line][2] == EMPTY && board[line][3] == EMPTY)
+                            AddIfPossible(4, line, 2, line, moves);
+                        else if(board[line][7] == rook && board[line][5] == EMPTY && board[line][6] == EMPTY)
+                            AddIfPossible(4, line, 6, line, moves);
+                    }
+                    break;
+                default:
+                    for(short dx=-1;dx<=1;++dx)
+                        for(short dy=-1;dy<=1;++dy) {
+                            if((!dx && !dy) || ((dx && dy) ? board[y][x] == W_ROOK || board[y][x] == B_ROOK : board[y][x] == W_BISHOP || board[y][x] == B_BISHOP))
+                                continue;
+                            for(short i=x+dx, j=y+dy; OnBoard(i, j); i+=dx, j+=dy) {
+                                AddIfPossible(x, y, i, j, moves);
+                                if(board[j][i] != EMPTY)
+                                    break;
+                            }
+                        }
+            }
+        }
+    std::sort(moves.begin(), moves.end());
+    return moves;
+}
+
+void ReferenceBoard::MakeMove(const std::string &move) noexcept {
+    const short &x1 = move[0]-'a', &y1 = '8'-move[1], &x2 = move[2]-'a', &y2 = '8'-move[3];
+    const char piece = board[y1][x1];
+    if((piece == W_PAWN || piece == B_PAWN) && x1 != x2 && board[y2][x2] == EMPTY)
+        board[y1][x2] = EMPTY;
+    if((piece == W_KING || piece == B_KING) && castling[whites_turn] && (x2 == 2 || x2 == 6))
+        std::swap(board[y1][x2 == 2 ? 0 : 7], board[y1][x2 == 2 ? 3 : 5]);
+    if(piece == W_KING || piece == B_KING || piece == W_ROOK || piece == B_ROOK)
+        castling[whites_turn] = false;
+    board[y2][x2] = (piece == W_PAWN && !y2) ? static_cast<char>(W_QUEEN) : (piece == B_PAWN && y2 == BOARD_SIZE-1) ? static_cast<char>(B_QUEEN) : piece;
+    board[y1][x1] = EMPTY;
+    double_step_file = ((piece == W_PAWN || piece == B_PAWN) && abs(y2-y1) == 2) ? x1 : -1;
+    whites_turn = !whites_turn;
+}
+
+bool ReferenceBoard::SameBoard(const BoardState &state) const noexcept {
+    for(short y=0;y<BOARD_SIZE;++y)
+        for(short x=0;x<BOARD_SIZE;++x)
+            if(board[y][x] != state.board[Mailbox(x, y)])
+                return false;
+    return state.whites_turn == whites_turn
+        && state.white_castling == castling[WHITE] && state.black_castling == castling[BLACK];
+}
+
+float ReferenceBoard::Evaluate() const noexcept {
+    static const float PIECE_VALUES[6] = {900, 90, 30, 30, 50, 10};
+    float evaluation = 0;
+    for(short y=0;y<BOARD_SIZE;++y)
+        for(short x=0;x<BOARD_SIZE;++x)
+            if(board[y][x] > 0)
+                evaluation += PIECE_VALUES[board[y][x]-1] + PIECE_POS_POINTS[board[y][x]-1][y][x];
+            else if(board[y][x] < 0)
+                evaluation -= PIECE_VALUES[board[y][x]+6] + PIECE_POS_POINTS[board[y][x]+6][BOARD_SIZE-y-1][x];
+    return evaluation;
+}
+
+HashKey ReferenceBoard::Key() const noexcept {
+    HashKey key = (whites_turn ? ZOBRIST.side : 0) ^ (castling[WHITE] ? ZOBRIST.castling[WHITE] : 0) ^ (castling[BLACK] ? ZOBRIST.castling[BLACK] : 0);
+    for(short y=0;y<BOARD_SIZE;++y)
+        for(short x=0;x<BOARD_SIZE;++x)
+            if(board[y][x] != EMPTY)
+                key ^= ZOBRIST.pieces[board[y][x] - B_KING][y*BOARD_SIZE + x];
+    const short &y = whites_turn ? 3 : 4;
+    const char &pawn = whites_turn ? W_PAWN : B_PAWN;
+    if(double_step_file != -1 && ((double_step_file > 0 && board[y][double_step_file-1] == pawn) || (double_step_file < BOARD_SIZE-1 && board[y][double_step_file+1] == pawn)))
+        key ^= ZOBRIST.en_passant[double_step_file];
+    return key;
+}
+
+// compares the game with the reference; returns an empty string if they agree, or what differs
+std::string CompareWithReference(Chess &c, const ReferenceBoard &reference) noexcept {
+    const BoardState &state = c.GetState();
+    if(!reference.SameBoard(state))
+        return "board, side to move or castling flags";
+    if(c.GetKey() != reference.Key())
+        return "Zobrist key";
+    if(c.EvaluateBoard(true) != reference.Evaluate())
+        return "evaluation";
+    if(c.EvaluateAllSquares(true) != reference.Evaluate())
+        return "full-board evaluation";
+#ifdef ATTACK_TABLES
+    const Bitboard &occupied = c.Occupancy();
+    for(short sq=0;sq<BOARD_SIZE*BOARD_SIZE;++sq) {
+        char white_attacker, black_attacker;
+        if(c.ScanAttackers<WHITE>(sq, occupied, white_attacker) != c.AttackCount<WHITE>(sq) || white_attacker != c.LeastValuableAttacker<WHITE>(sq)
+           || c.ScanAttackers<BLACK>(sq, occupied, black_attacker) != c.AttackCount<BLACK>(sq) || black_attacker != c.LeastValuableAttacker<BLACK>(sq))
+            return "attack tables";
+    }
+#endif
+    const auto &all_moves = c.AllMoves();
+    std::vector<std::string> moves(all_moves.cbegin(), all_moves.cend());
+    std::sort(moves.begin(), moves.end());
+    if(moves != reference.LegalMoves())
+        return "legal moves";
+    if(c.HasLegalMove() == moves.empty())
+        return "legal move test";
+    for(auto move : moves) {
+        const HashKey &key = c.GetKey();
+        Chess::ChangeToRealCoordinates(move[0], move[1], move[2], move[3]);
+        c.MovePiece(move[0], move[1], move[2], move[3], false, false);
+        c.MovePieceBack(move[0], move[1], move[2], move[3]);
+        const BoardState &undone = c.GetState();
+        if(!reference.SameBoard(undone) || undone.piece_key != state.piece_key || c.GetKey() != key
+#ifdef ATTACK_TABLES
+           || std::memcmp(&undone.attacks, &state.attacks, sizeof(AttackTables))
+#endif
+          )
+            return "make/unmake of " + Chess::ToCoordinateString(move);
+    }
+    return "";
+}
+
+// Plays random games with a seeded generator and checks every position against the reference; prints the moves
+// leading to the first difference, so that it can be reproduced with perft. Returns false if a difference was found.
+// Checks what chessbot.h promises about calls from the callback of a search of the C interface: the engine is busy,
+// chessbot_wait returns at once, and chessbot_destroy returns normally and leaves the engine to be deleted by the
+// search thread. Gives up after ten seconds.
+bool CheckSearchCallback() noexcept {
+    typedef struct {
+        chessbot_engine *engine;
+        std::mutex mutex;
+        std::condition_variable done;
+        bool returned, busy;
+    } CallbackState;
+    CallbackState state;
+    state.engine = chessbot_create(), state.returned = state.busy = false;
+    chessbot_limits limits = {};
+    limits.depth = 1;
+    if(!state.engine || chessbot_start_search(state.engine, &limits, [](const char *, void *user_data) {
+        CallbackState &state = *static_cast<CallbackState*>(user_data);
+        chessbot_limits next = {};
+        char buffer[8];
+        const bool &busy = chessbot_set_position(state.engine, nullptr, nullptr) == CHESSBOT_ERROR_BUSY
+                           && chessbot_legal_moves(state.engine, buffer, sizeof(buffer)) == CHESSBOT_ERROR_BUSY
+                           && chessbot_start_search(state.engine, &next, [](const char *, void *) {}, nullptr) == CHESSBOT_ERROR_BUSY;
+        chessbot_wait(state.engine);
+        chessbot_destroy(state.engine);
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.returned = true, state.busy = busy;
+        state.done.notify_all();
+    }, &state) != CHESSBOT_OK)
+        return false;
+    std::unique_lock<std::mutex> lock(state.mutex);
+    return state.done.wait_for(lock, std::chrono::seconds(10), [&state]() { return state.returned; }) && state.busy;
+}
+
+bool RunFuzzer(const unsigned long &games, const unsigned long &seed, const unsigned short &max_plies) noexcept {
+    std::mt19937_64 random(seed);
+    unsigned long long positions = 0;
+    for(unsigned long game=0;game<games;++game) {
+        Chess c("Fuzz1", 1, "Fuzz2", 1);
+        ReferenceBoard reference;
+        std::string played;
+        std::vector<PackedPosition> packed;
+        std::vector<float> expected;
+        for(unsigned short ply=0;ply<max_plies;++ply, ++positions) {
+            const std::string &difference = CompareWithReference(c, reference);
+            if(!difference.empty()) {
+                std::cout << "Mismatch in " << difference << " after moves \"" << played << "\" (game " << game+1 << ", seed " << seed << ")" << std::endl;
+                return false;
+            }
+            packed.push_back(c.Pack());
+            expected.push_back(c.EvaluateBoard(c.GetTurn()));
+            const auto &moves = reference.LegalMoves();
+            if(moves.empty())
+                break;
+            const std::string &move = moves[random() % moves.size()];
+            c.PlayMove(move);
+            reference.MakeMove(move);
+            played += (played.empty() ? "" : " ") + move;
+        }
+        std::vector<float> evaluations(packed.size());
+        Chess::EvaluatePositions(packed.data(), packed.size(), evaluations.data());
+        for(size_t ply=0;ply<packed.size();++ply)
+            if(evaluations[ply] != expected[ply]) {
+                std::cout << "Mismatch in batch evaluation at ply " << ply << " of game " << game+1 << " (seed " << seed << ")" << std::endl;
+                return false;
+            }
+    }
+    if(!CheckSearchCallback()) {
+        std::cout << "Calls from a search callback of the C interface do not behave as chessbot.h describes" << std::endl;
+        return false;
+    }
+    std::cout << "Fuzzed " << games << " games, " << positions << " positions: no mismatches" << std::endl;
+    return true;
+}
+
+// --- C Interface ---
+// an engine of the library: the game holding its position, the bot searching it, and the thread the bot searches on
+struct chessbot_engine {
+    Chess game{"White", 0, "Black", 0};
+    Bot bot{"ChessBot", MAX_SEARCH_DEPTH};
+    std::thread search;
+    std::mutex search_mutex;                // guards 'search', which may still be being assigned when its search has already ended
+    std::atomic<bool> stop{false};
+    std::atomic<bool> searching{false};
+    bool destroyed = false;                 // by the callback, which leaves deleting the engine to the search thread
+};
+
+// the engine whose search runs on this thread, if any
+static thread_local const chessbot_engine *current_search = nullptr;
+
+int chessbot_abi_version(void) {
+    return CHESSBOT_ABI_VERSION;
+}
+
+chessbot_engine *chessbot_create(void) {
+    chessbot_engine *engine = new(std::nothrow) chessbot_engine;
+    if(engine)
+        engine->bot.SetStopSignal(&engine->stop);
+    return engine;
+}
+
+void chessbot_destroy(chessbot_engine *engine) {
+    if(!engine)
+        return;
+    if(current_search == engine) {
+        engine->destroyed = true;
+        return;
+    }
+    chessbot_stop_search(engine);
+    chessbot_wait(engine);
+    delete engine;
+}
+
+// sets the position up on a separate game first, so that a failure leaves the engine's position alone
+int chessbot_set_position(chessbot_engine *engine, const char *fen, const char *moves) {
+    if(!engine)
+        return CHESSBOT_ERROR_ARGUMENT;
+    if(engine->searching)
+        return CHESSBOT_ERROR_BUSY;
+    try {
+        Chess game("White", 0, "Black", 0);
+        if((fen && strcmp(fen, "startpos") && !game.SetPosition(fen)) || !SetUpPosition(game, moves ? moves : ""))
+            return CHESSBOT_ERROR_POSITION;
+        engine->game = game;
+    }
+    catch(...) {
+        return CHESSBOT_ERROR_RESOURCES;
+    }
+    return CHESSBOT_OK;
+}
+
+int chessbot_legal_moves(chessbot_engine *engine, char *buffer, size_t size) {
+    if(!engine || (!buffer && size))
+        return CHESSBOT_ERROR_ARGUMENT;
+    if(engine->searching)
+        return CHESSBOT_ERROR_BUSY;
+    std::string list;
+    int count = 0;
+    for(const auto &move : engine->game.AllMoves())
+        list += (count++ ? " " : "") + move;
+    if(list.length() >= size)
+        return CHESSBOT_ERROR_BUFFER;
+    memcpy(buffer, list.c_str(), list.length() + 1);
+    return count;
+}
+
+int chessbot_start_search(chessbot_engine *engine, const chessbot_limits *limits, chessbot_bestmove_callback callback, void *user_data) {
+    if(!engine || !limits || !callback)
+        return CHESSBOT_ERROR_ARGUMENT;
+    if(engine->searching.exchange(true))        // claims the engine, so that concurrent calls cannot both start a search
+        return CHESSBOT_ERROR_BUSY;
+    chessbot_wait(engine);
+    const chessbot_limits search_limits = *limits;
+    engine->stop = false;
+    std::lock_guard<std::mutex> lock(engine->search_mutex);
+    try {
+        engine->bot.SetThreads(search_limits.threads, search_limits.mode == CHESSBOT_YOUNG_BROTHERS_WAIT ? YOUNG_BROTHERS_WAIT : LAZY_SMP);
+        engine->search = std::thread([engine, search_limits, callback, user_data]() {
+            current_search = engine;
+            const unsigned short &depth = search_limits.depth ? std::min<unsigned int>(search_limits.depth, MAX_SEARCH_DEPTH) : MAX_SEARCH_DEPTH;
+            const GameClock clock = {search_limits.white_time, search_limits.black_time, search_limits.white_increment, search_limits.black_increment,
+                                     static_cast<unsigned short>(search_limits.moves_to_go)};
+            const std::string &move = clock.white_time || clock.black_time ? engine->bot.GetIdealMove(engine->game, clock, depth)
+                                      : engine->bot.GetIdealMove(engine->game, depth);
+            callback(move.empty() ? "" : Chess::ToCoordinateString(move).c_str(), user_data);
+            if(engine->destroyed) {        // nobody is left to join the thread
+                {
+                    std::lock_guard<std::mutex> lock(engine->search_mutex);
+                    engine->search.detach();
+                }
+                delete engine;
+                return;
+            }
+            engine->searching = false;
+        });
+    }
+    catch(...) {
+        engine->searching = false;
+        return CHESSBOT_ERROR_RESOURCES;
+    }
+    return CHESSBOT_OK;
+}
+
+void chessbot_stop_search(chessbot_engine *engine) {
+    if(engine)
+        engine->stop = true;
+}
+
+// does nothing when called from the callback, which runs on the search thread itself
+void chessbot_wait(chessbot_engine *engine) {
+    if(!engine || current_search == engine)
+        return;
+    std::lock_guard<std::mutex> lock(engine->search_mutex);
+    if(engine->search.joinable())
+        engine->search.join();
+}
+
 // --- main() ---
-int main() {
+#ifndef CHESSBOT_LIBRARY
+int main(int argc, char *argv[]) {
+    if(argc > 1 && !std::string(argv[1]).compare("bench")) {
+        RunBenchmark(argc > 2 ? atoi(argv[2]) : 4, argc > 3 ? atoi(argv[3]) : 3);
+        return 0;
+    }
+    if(argc > 2 && !std::string(argv[1]).compare("perft")) {
+        RunPerft(atoi(argv[2]), argc > 3 ? atoi(argv[3]) : std::max(1u, std::thread::hardware_concurrency()), argc > 4 ? atoi(argv[4]) : 64, argc > 5 ? argv[5] : "");
+        return 0;
+    }
+    if(argc > 3 && !std::string(argv[1]).compare("go")) {
+        RunTimedSearch({atoll(argv[2]), atoll(argv[3]), argc > 4 ? atoll(argv[4]) : 0, argc > 5 ? atoll(argv[5]) : 0,
+                        static_cast<unsigned short>(argc > 6 ? atoi(argv[6]) : 0)}, argc > 7 ? argv[7] : "",
+                       argc > 8 ? atoi(argv[8]) : 1, argc > 9 && !std::string(argv[9]).compare("ybwc") ? YOUNG_BROTHERS_WAIT : LAZY_SMP);
+        return 0;
+    }
+    if(argc > 1 && !std::string(argv[1]).compare("smp")) {
+        const std::string &mode = argc > 5 ? argv[5] : "both";
+        for(const auto &parallel_mode : {LAZY_SMP, YOUNG_BROTHERS_WAIT})
+            if(!mode.compare("both") || !mode.compare(parallel_mode == LAZY_SMP ? "lazy" : "ybwc"))
+                RunSmpBenchmark(argc > 2 ? atoi(argv[2]) : std::max(1u, std::thread::hardware_concurrency()), argc > 3 ? atoi(argv[3]) : 4,
+                                argc > 4 ? atoi(argv[4]) : SMP_BENCH_RUNS, parallel_mode);
+        return 0;
+    }
+    if(argc > 1 && !std::string(argv[1]).compare("sessions")) {
+        const size_t &count = argc > 2 ? atol(argv[2]) : 1000;
+        RunSessionBenchmark(count, argc > 3 ? atoi(argv[3]) : 40, argc > 4 ? atoi(argv[4]) : 1, argc > 5 ? atoi(argv[5]) : std::max(1u, std::thread::hardware_concurrency()),
+                            argc > 6 ? atol(argv[6]) : count, argc > 7 ? argv[7] : "chessbot-sessions.store");
+        return 0;
+    }
+    if(argc > 1 && !std::string(argv[1]).compare("serve")) {
+        const unsigned short threads = argc > 2 ? atoi(argv[2]) : std::max(1u, std::thread::hardware_concurrency());
+        LoadPolicy policy = DEFAULT_LOAD_POLICY;
+        if(argc > 5)
+            policy.max_level = atoi(argv[5]);
+        RunServer(threads, argc > 4 ? atoi(argv[4]) : std::max(threads - 1, 1), argc > 3 ? atol(argv[3]) : ANALYSIS_CACHE_ENTRIES, policy);
+        return 0;
+    }
+    if(argc > 1 && !std::string(argv[1]).compare("load")) {
+        const unsigned short threads = argc > 5 ? atoi(argv[5]) : std::max(1u, std::thread::hardware_concurrency());
+        RunLoadTest(argc > 2 && std::string(argv[2]).compare("synthetic") ? argv[2] : "", argc > 6 ? atol(argv[6]) : LOAD_REQUESTS, argc > 3 ? atof(argv[3]) : 0,
+                    argc > 4 ? atol(argv[4]) : 64, threads, std::max(threads - 1, 1), ANALYSIS_CACHE_ENTRIES, DEFAULT_LOAD_POLICY);
+        return 0;
+    }
+    if(argc > 1 && !std::string(argv[1]).compare("fuzz"))
+        return RunFuzzer(argc > 2 ? atol(argv[2]) : 1000, argc > 3 ? atol(argv[3]) : 1, argc > 4 ? atoi(argv[4]) : 200) ? 0 : 1;
     std::cout << "Welcome to ChessBot!" << std::endl;
     srand((unsigned int)time(NULL));
 
@@ -1231,3 +4497,4 @@ int main() {
         } while (c.GameOver());
     }
 }
+#endif